@@ -7,6 +7,7 @@
 #include <iostream>
 #include <memory>
 #include <cstring>
+#include <stdexcept>
 
 namespace kdtree {
 template<typename T, std::size_t Dim>
@@ -21,22 +22,9 @@ public:
     /// size :  size[i] = max_index[i] - min_index[i] + 1;
 
     Array(const Size &_size) :
-        size(_size),
-        data_size(1)
+        data_size(0)
     {
-        for(std::size_t i = 0 ; i < Dim ; ++i) {
-            data_size *= _size[i];
-        }
-
-        steps[0] = 1;
-        if(Dim > 1) {
-            std::size_t max_i = Dim - 1;
-            for(std::size_t i = 1 ; i <= max_i ; ++i) {
-                steps[i] = steps[i-1] * size[i-1];
-            }
-        }
-        data.resize(data_size);
-        data_ptr = data.data();
+        resize(_size);
     }
 
     Array(const Array &other) = delete;
@@ -54,12 +42,44 @@ public:
         return data_ptr[pos];
     }
 
+    /// no range check, for indices already known to lie inside size
+    inline T & at_unchecked(const Index &_index) const
+    {
+        std::size_t pos = 0;
+        for(std::size_t i = 0 ; i < Dim ; ++i) {
+            pos += _index[i] * steps[i];
+        }
+        return data_ptr[pos];
+    }
+
+    /// new size, the memory is kept when shrinking, contents are undefined until reset()
+    inline void resize(const Size &_size)
+    {
+        size = _size;
+        data_size = 1;
+        for(std::size_t i = 0 ; i < Dim ; ++i) {
+            data_size *= _size[i];
+        }
+
+        steps[0] = 1;
+        for(std::size_t i = 1 ; i < Dim ; ++i) {
+            steps[i] = steps[i-1] * size[i-1];
+        }
+        data.resize(data_size);
+        data_ptr = data.data();
+    }
+
     inline void reset(const T &_v)
     {
-        data.resize(data_size, _v);
+        data.assign(data_size, _v);
         data_ptr = data.data();
     }
 
+    inline const Size & getSize() const
+    {
+        return size;
+    }
+
     inline void printInfo() const
     {
         std::cout << "[Array :] " << (data_size * sizeof(T)) / (1024.0 * 1024.0) << "MB" << std::endl;
@@ -71,11 +91,11 @@ public:
     }
 
 private:
-    inline std::size_t pos(const Index &_index) {
+    inline std::size_t pos(const Index &_index) const {
         std::size_t pos = 0;
         for(std::size_t i = 0 ; i < Dim ; ++i) {
             std::size_t id = _index[i];
-            if(id > size[i]) {
+            if(id >= size[i]) {
                 throw  std::out_of_range("Index was out of range!");
             }
             pos += id * steps[i];
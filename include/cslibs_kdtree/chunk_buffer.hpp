@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace kdtree
+{
+
+/// Growable storage that allocates its elements in fixed size chunks.
+/// Elements never move once allocated, so pointers to them stay valid while
+/// the buffer grows. Chunk sizes are rounded up to a power of two.
+template<typename T>
+class ChunkBuffer
+{
+public:
+    typedef T                       ValueType;
+    typedef std::unique_ptr<T[]>    ChunkType;
+
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE = 4096;
+
+public:
+    ChunkBuffer(std::size_t chunk_size = DEFAULT_CHUNK_SIZE) :
+        _chunk_shift(0),
+        _capacity(0)
+    {
+        while ((std::size_t(1) << _chunk_shift) < chunk_size)
+            ++_chunk_shift;
+        _chunk_mask = (std::size_t(1) << _chunk_shift) - 1;
+    }
+
+    /// disallow copy
+    ChunkBuffer(const ChunkBuffer&) = delete;
+    ChunkBuffer& operator=(const ChunkBuffer&) = delete;
+
+    inline void reserve(std::size_t capacity)
+    {
+        while (_capacity < capacity)
+        {
+            _chunks.emplace_back(new T[chunk_size()]);
+            _capacity += chunk_size();
+        }
+    }
+
+    inline T& operator[](std::size_t i)
+    {
+        return _chunks[i >> _chunk_shift][i & _chunk_mask];
+    }
+
+    inline const T& operator[](std::size_t i) const
+    {
+        return _chunks[i >> _chunk_shift][i & _chunk_mask];
+    }
+
+    /// visit the first count elements, one contiguous chunk at a time
+    template<typename F>
+    inline void for_each(std::size_t count, F&& fun)
+    {
+        count = std::min(count, _capacity);
+        for (std::size_t c = 0; count > 0; ++c)
+        {
+            const std::size_t n = std::min(count, chunk_size());
+            T* chunk = _chunks[c].get();
+            for (std::size_t i = 0; i < n; ++i)
+                fun(chunk[i]);
+            count -= n;
+        }
+    }
+
+    inline std::size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    inline std::size_t chunk_size() const
+    {
+        return _chunk_mask + 1;
+    }
+
+    inline std::size_t chunk_count() const
+    {
+        return _chunks.size();
+    }
+
+private:
+    std::size_t            _chunk_shift;
+    std::size_t            _chunk_mask;
+    std::size_t            _capacity;
+    std::vector<ChunkType> _chunks;
+};
+
+}
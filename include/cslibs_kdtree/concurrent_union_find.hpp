@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+namespace kdtree
+{
+
+/// Lock-free disjoint-set over the elements 0 .. size-1. Roots are always
+/// linked below the smaller element, so the root of every set is its
+/// smallest element, independent of the order in which threads unite.
+class ConcurrentUnionFind
+{
+public:
+    typedef std::uint32_t ElementType;
+
+    ConcurrentUnionFind() :
+        _size(0),
+        _capacity(0)
+    {
+    }
+
+    /// disallow copy
+    ConcurrentUnionFind(const ConcurrentUnionFind&) = delete;
+    ConcurrentUnionFind& operator=(const ConcurrentUnionFind&) = delete;
+
+    /// makes every element its own set, not thread safe
+    inline void reset(std::size_t size)
+    {
+        if (size > _capacity)
+        {
+            _parents.reset(new std::atomic<ElementType>[size]);
+            _capacity = size;
+        }
+
+        _size = size;
+        for (std::size_t i = 0; i < size; ++i)
+            _parents[i].store(static_cast<ElementType>(i), std::memory_order_relaxed);
+    }
+
+    inline ElementType find(ElementType x)
+    {
+        while (true)
+        {
+            ElementType parent = _parents[x].load(std::memory_order_relaxed);
+            if (parent == x)
+                return x;
+
+            /// path halving, a failed exchange only means someone else shortened it
+            const ElementType grand_parent = _parents[parent].load(std::memory_order_relaxed);
+            if (parent != grand_parent)
+                _parents[x].compare_exchange_weak(parent, grand_parent, std::memory_order_relaxed);
+            x = grand_parent;
+        }
+    }
+
+    inline void unite(ElementType a, ElementType b)
+    {
+        while (true)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+                return;
+
+            ElementType high = a > b ? a : b;
+            const ElementType low = a > b ? b : a;
+            if (_parents[high].compare_exchange_strong(high, low, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    inline std::size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    std::size_t _size;
+    std::size_t _capacity;
+    std::unique_ptr<std::atomic<ElementType>[]> _parents;
+};
+
+}
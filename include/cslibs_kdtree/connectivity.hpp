@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <type_traits>
+
+namespace kdtree {
+namespace detail
+{
+    namespace math
+    {
+        constexpr std::size_t power(std::size_t base, std::size_t exponent)
+        {
+            return exponent == 0 ? 1 : base * power(base, exponent - 1);
+        }
+
+        constexpr std::size_t binomial(std::size_t n, std::size_t k)
+        {
+            return k > n ? 0 : (k == 0 ? 1 : binomial(n - 1, k - 1) * n / k);
+        }
+
+        /// offsets in [-radius, radius]^dim with at most changed non zero components
+        constexpr std::size_t connectivity_rows(std::size_t dim, std::size_t changed, std::size_t radius, std::size_t j = 0)
+        {
+            return (j > dim || j > changed) ? 0 :
+                   binomial(dim, j) * power(2 * radius, j) + connectivity_rows(dim, changed, radius, j + 1);
+        }
+    }
+}
+
+/// Neighbourhood masks chosen at compile time. The mask holds every offset
+/// with components in [-Radius, Radius] of which at most MaxChanged are non
+/// zero, the zero offset included. Rows are ordered with the last dimension
+/// running fastest, so the mask mirrors around its zero center as the full
+/// mask of detail::fill does. Periodic dimensions need a period above
+/// 2 * Radius.
+template<std::size_t MaxChanged, std::size_t Radius = 1>
+struct Connectivity
+{
+    static_assert(Radius > 0, "Radius > 0 required!");
+
+    static constexpr std::size_t radius = Radius;
+
+    template<typename T, std::size_t Dim>
+    struct Mask
+    {
+        static constexpr std::size_t rows = detail::math::connectivity_rows(Dim, MaxChanged, Radius);
+        static constexpr std::size_t cols = Dim;
+        typedef std::array<T, rows> Type;
+
+        static inline void assign(Type &_value)
+        {
+            typedef typename std::decay<decltype(_value[0][0])>::type value_type;
+
+            const std::size_t side  = 2 * Radius + 1;
+            const std::size_t total = detail::math::power(side, Dim);
+            std::size_t row = 0;
+            T offset;
+            for(std::size_t c = 0 ; c < total ; ++c) {
+                std::size_t rest    = c;
+                std::size_t changed = 0;
+                for(std::size_t i = Dim ; i-- > 0 ;) {
+                    const long long component = static_cast<long long>(rest % side) - static_cast<long long>(Radius);
+                    offset[i] = static_cast<value_type>(component);
+                    changed += component != 0;
+                    rest /= side;
+                }
+                if(changed <= MaxChanged)
+                    _value[row++] = offset;
+            }
+        }
+    };
+};
+
+/// offsets sharing a face, 2 * Dim neighbours
+typedef Connectivity<1>                                      ConnectivityFace;
+/// offsets sharing a face or an edge
+typedef Connectivity<2>                                      ConnectivityEdge;
+/// every offset of the 3^Dim cube
+typedef Connectivity<std::numeric_limits<std::size_t>::max()> ConnectivityFull;
+/// every offset up to Radius cells apart per dimension, for coarse bins
+template<std::size_t Radius>
+using ConnectivityRadius = Connectivity<std::numeric_limits<std::size_t>::max(), Radius>;
+
+template<std::size_t MaxChanged, std::size_t Radius>
+constexpr std::size_t Connectivity<MaxChanged, Radius>::radius;
+template<std::size_t MaxChanged, std::size_t Radius>
+template<typename T, std::size_t Dim>
+constexpr std::size_t Connectivity<MaxChanged, Radius>::Mask<T, Dim>::rows;
+}
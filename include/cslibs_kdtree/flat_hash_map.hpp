@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace kdtree
+{
+
+struct FlatHashMapStatistics
+{
+    std::size_t lookups     = 0;    /// find and emplace calls
+    std::size_t collisions  = 0;    /// lookups whose home slot held another key
+    std::size_t probes      = 0;    /// slots inspected past the home slot
+
+    inline void count_lookup()    { ++lookups; }
+    inline void count_collision() { ++collisions; }
+    inline void count_probe()     { ++probes; }
+};
+
+/// counting layer that compiles away, used unless statistics are requested
+struct FlatHashMapNoStatistics
+{
+    inline void count_lookup()    {}
+    inline void count_collision() {}
+    inline void count_probe()     {}
+};
+
+/// Open addressing hash map with linear probing for the bulk load buffers.
+/// Entries are kept densely in insertion order, the probe table only holds
+/// entry positions and hash tags. clear() keeps all memory for the next frame.
+/// Probe statistics are only counted with Statistics = true.
+template<typename Key, typename Value, typename Hash = std::hash<Key>, bool Statistics = false>
+class FlatHashMap
+{
+public:
+    typedef Key                                 KeyType;
+    typedef Value                               ValueType;
+    typedef std::pair<KeyType, ValueType>       EntryType;
+    typedef std::vector<EntryType>              EntriesType;
+    typedef typename EntriesType::iterator      iterator;
+    typedef typename std::conditional<Statistics,
+                                      FlatHashMapStatistics,
+                                      FlatHashMapNoStatistics>::type StatisticsType;
+
+    static constexpr std::size_t DEFAULT_CAPACITY = 1024;
+
+public:
+    FlatHashMap(std::size_t capacity = DEFAULT_CAPACITY)
+    {
+        std::size_t slots = 16;
+        while (slots < 2 * capacity)
+            slots *= 2;
+
+        _slots.resize(slots);
+        _entries.reserve(capacity);
+    }
+
+    /// disallow copy
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    inline ValueType* find(const KeyType& key)
+    {
+        const std::size_t hash = _hash(key);
+        const std::size_t slot = probe(key, hash, _statistics);
+        if (_slots[slot].entry == EMPTY)
+            return nullptr;
+
+        return &(_entries[_slots[slot].entry].second);
+    }
+
+    /// read only lookup without statistics, safe for concurrent readers
+    inline const ValueType* lookup(const KeyType& key) const
+    {
+        FlatHashMapNoStatistics counter;
+        const std::size_t slot = probe(key, _hash(key), counter);
+        if (_slots[slot].entry == EMPTY)
+            return nullptr;
+
+        return &(_entries[_slots[slot].entry].second);
+    }
+
+    /// value is only moved from if the key was not present yet
+    inline std::pair<ValueType*, bool> emplace(KeyType&& key, ValueType&& value)
+    {
+        if (2 * (_entries.size() + 1) > _slots.size())
+            rehash(2 * _slots.size());
+
+        const std::size_t hash = _hash(key);
+        const std::size_t slot = probe(key, hash, _statistics);
+        if (_slots[slot].entry != EMPTY)
+            return std::make_pair(&(_entries[_slots[slot].entry].second), false);
+
+        _slots[slot].entry = static_cast<std::uint32_t>(_entries.size());
+        _slots[slot].tag = tag(hash);
+        _entries.emplace_back(std::move(key), std::move(value));
+        return std::make_pair(&(_entries.back().second), true);
+    }
+
+    inline void clear()
+    {
+        if (_entries.empty())
+            return;
+
+        std::fill(_slots.begin(), _slots.end(), Slot());
+        _entries.clear();
+    }
+
+    inline bool empty() const
+    {
+        return _entries.empty();
+    }
+
+    inline std::size_t size() const
+    {
+        return _entries.size();
+    }
+
+    inline std::size_t bucket_count() const
+    {
+        return _slots.size();
+    }
+
+    inline iterator begin()
+    {
+        return _entries.begin();
+    }
+
+    inline iterator end()
+    {
+        return _entries.end();
+    }
+
+    /// dense entry storage, may be reordered or moved from before clear()
+    inline EntriesType& entries()
+    {
+        return _entries;
+    }
+
+    inline const FlatHashMapStatistics& statistics() const
+    {
+        static_assert(Statistics, "statistics are only counted with Statistics = true");
+        return _statistics;
+    }
+
+    inline void reset_statistics()
+    {
+        static_assert(Statistics, "statistics are only counted with Statistics = true");
+        _statistics = StatisticsType();
+    }
+
+private:
+    static constexpr std::uint32_t EMPTY = static_cast<std::uint32_t>(-1);
+
+    struct Slot
+    {
+        std::uint32_t entry = EMPTY;
+        std::uint32_t tag   = 0;
+    };
+
+    static inline std::uint32_t tag(std::size_t hash)
+    {
+        return static_cast<std::uint32_t>(hash >> (8 * sizeof(std::size_t) - 32));
+    }
+
+    /// slot holding key or the empty slot where it belongs
+    template<typename Counter>
+    inline std::size_t probe(const KeyType& key, std::size_t hash, Counter& counter) const
+    {
+        const std::size_t mask = _slots.size() - 1;
+        const std::uint32_t key_tag = tag(hash);
+        std::size_t slot = hash & mask;
+
+        counter.count_lookup();
+        bool home = true;
+        while (true)
+        {
+            const Slot& s = _slots[slot];
+            if (s.entry == EMPTY)
+                return slot;
+            if (s.tag == key_tag && _entries[s.entry].first == key)
+                return slot;
+
+            if (home)
+                counter.count_collision();
+            home = false;
+            counter.count_probe();
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    inline void rehash(std::size_t slots)
+    {
+        _slots.assign(slots, Slot());
+        const std::size_t mask = slots - 1;
+        for (std::size_t i = 0; i < _entries.size(); ++i)
+        {
+            const std::size_t hash = _hash(_entries[i].first);
+            std::size_t slot = hash & mask;
+            while (_slots[slot].entry != EMPTY)
+                slot = (slot + 1) & mask;
+
+            _slots[slot].entry = static_cast<std::uint32_t>(i);
+            _slots[slot].tag = tag(hash);
+        }
+    }
+
+private:
+    Hash                  _hash;
+    std::vector<Slot>     _slots;
+    EntriesType           _entries;
+    StatisticsType        _statistics;
+};
+
+}
@@ -3,11 +3,14 @@
 
 #include <array>
 #include <limits>
+#include <algorithm>
+#include "index_simd.hpp"
 
 namespace kdtree {
 
+/// per dimension loops, fallback for every index type
 template <std::size_t Dim, typename S, typename D>
-struct ArrayOperations {
+struct ArrayOperationsScalar {
     typedef S                  src_type;
     typedef D                  dst_type;
     typedef std::array<D, Dim> dst_array_type;
@@ -54,6 +57,7 @@ struct ArrayOperations {
         for(std::size_t i = 0 ; i < Dim ; ++i) {
             dst[i] = (dst_type)(_a[i] + _b[i]);
         }
+        return dst;
     }
 
     static inline void add(dst_array_type &_dst,
@@ -73,6 +77,17 @@ struct ArrayOperations {
         }
     }
 
+    /// _dst[k] = _base + _offsets[k] for count offsets, e.g. a whole neighbourhood mask
+    static inline void add_each(const src_array_type &_base,
+                                const src_array_type *_offsets,
+                                dst_array_type *_dst,
+                                std::size_t count)
+    {
+        for(std::size_t k = 0 ; k < count ; ++k) {
+            add(_base, _offsets[k], _dst[k]);
+        }
+    }
+
     static inline dst_array_type sub(const src_array_type &_a,
                                      const src_array_type &_b)
     {
@@ -118,9 +133,9 @@ struct ArrayOperations {
         }
     }
 
-    static inline dst_array_type cwise_min(const src_array_type &_a,
-                                           const src_array_type &_b,
-                                           dst_array_type &_dst)
+    static inline void cwise_min(const src_array_type &_a,
+                                 const src_array_type &_b,
+                                 dst_array_type &_dst)
     {
         for(std::size_t i = 0 ; i < Dim ; ++i) {
             _dst[i] = std::min(_a[i], _b[i]);
@@ -145,9 +160,9 @@ struct ArrayOperations {
         }
     }
 
-    static inline dst_array_type cwise_max(const src_array_type &_a,
-                                           const src_array_type &_b,
-                                           dst_array_type &_dst)
+    static inline void cwise_max(const src_array_type &_a,
+                                 const src_array_type &_b,
+                                 dst_array_type &_dst)
     {
         for(std::size_t i = 0 ; i < Dim ; ++i) {
             _dst[i] = std::max(_a[i], _b[i]);
@@ -172,5 +187,163 @@ struct ArrayOperations {
         return dst;
     }
 };
+
+template <std::size_t Dim, typename S, typename D, typename Enable = void>
+struct ArrayOperations : public ArrayOperationsScalar<Dim, S, D> {
+};
+
+/// int indices of 2 to 8 dimensions with vector paths chosen by the target
+/// flags (SSE2, SSE4.1, AVX2), everything else stays scalar. Single arrays go
+/// through vector registers for 4 to 7 dimensions only, the compiler keeps
+/// 2 or 3 lanes in scalar registers and vectorizes 8 lanes on its own.
+template <std::size_t Dim>
+struct ArrayOperations<Dim, int, int, typename std::enable_if<detail::int_vector<Dim>::enabled>::type> :
+        public ArrayOperationsScalar<Dim, int, int> {
+    typedef ArrayOperationsScalar<Dim, int, int> scalar_type;
+    typedef detail::int_vector<Dim>              vector_type;
+    typedef typename scalar_type::src_array_type src_array_type;
+    typedef typename scalar_type::dst_array_type dst_array_type;
+
+    static constexpr bool vectorize = Dim >= 4 && Dim < 8;
+
+    static_assert(sizeof(src_array_type) == Dim * sizeof(int), "index arrays have to be packed");
+
+    static inline bool equals (const src_array_type &_a,
+                               const src_array_type &_b)
+    {
+        if(!vectorize) {
+            return scalar_type::equals(_a, _b);
+        }
+        return vector_type::equals(vector_type::load(_a), vector_type::load(_b));
+    }
+
+    static inline dst_array_type add(const src_array_type &_a,
+                                     const src_array_type &_b)
+    {
+        dst_array_type dst;
+        add(_a, _b, dst);
+        return dst;
+    }
+
+    static inline void add(dst_array_type &_dst,
+                           const src_array_type &_src)
+    {
+        add(_dst, _src, _dst);
+    }
+
+    static inline void add(const src_array_type &_a,
+                           const src_array_type &_b,
+                           dst_array_type &_dst)
+    {
+        if(!vectorize) {
+            scalar_type::add(_a, _b, _dst);
+            return;
+        }
+        vector_type::add(vector_type::load(_a), vector_type::load(_b)).store(_dst);
+    }
+
+    /// the base is tiled into Dim registers that cover 4 whole packed offsets,
+    /// so every 4 offsets take Dim vector adds
+    static inline void add_each(const src_array_type &_base,
+                                const src_array_type *_offsets,
+                                dst_array_type *_dst,
+                                std::size_t count)
+    {
+        __m128i pattern[Dim];
+        for(std::size_t j = 0 ; j < Dim ; ++j) {
+            pattern[j] = _mm_setr_epi32(_base[(4 * j) % Dim],     _base[(4 * j + 1) % Dim],
+                                        _base[(4 * j + 2) % Dim], _base[(4 * j + 3) % Dim]);
+        }
+
+        const std::size_t blocks = count - count % 4;
+        std::size_t k = 0;
+        for(; k < blocks ; k += 4) {
+            const int *src = _offsets[k].data();
+            int *dst = _dst[k].data();
+            for(std::size_t j = 0 ; j < Dim ; ++j) {
+                const __m128i offset = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * j));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 4 * j), _mm_add_epi32(offset, pattern[j]));
+            }
+        }
+        for(; k < count ; ++k) {
+            scalar_type::add(_base, _offsets[k], _dst[k]);
+        }
+    }
+
+    static inline dst_array_type sub(const src_array_type &_a,
+                                     const src_array_type &_b)
+    {
+        dst_array_type dst;
+        sub(_a, _b, dst);
+        return dst;
+    }
+
+    static inline void sub(dst_array_type &_dst,
+                           const src_array_type &_src)
+    {
+        sub(_dst, _src, _dst);
+    }
+
+    static inline void sub(const src_array_type &_a,
+                           const src_array_type &_b,
+                           dst_array_type &_dst)
+    {
+        if(!vectorize) {
+            scalar_type::sub(_a, _b, _dst);
+            return;
+        }
+        vector_type::sub(vector_type::load(_a), vector_type::load(_b)).store(_dst);
+    }
+
+    static inline dst_array_type cwise_min(const src_array_type &_a,
+                                           const src_array_type &_b)
+    {
+        dst_array_type dst;
+        cwise_min(_a, _b, dst);
+        return dst;
+    }
+
+    static inline void cwise_min(const src_array_type &_src,
+                                 dst_array_type &_dst)
+    {
+        cwise_min(_src, _dst, _dst);
+    }
+
+    static inline void cwise_min(const src_array_type &_a,
+                                 const src_array_type &_b,
+                                 dst_array_type &_dst)
+    {
+        if(!vectorize) {
+            scalar_type::cwise_min(_a, _b, _dst);
+            return;
+        }
+        vector_type::min(vector_type::load(_a), vector_type::load(_b)).store(_dst);
+    }
+
+    static inline dst_array_type cwise_max(const src_array_type &_a,
+                                           const src_array_type &_b)
+    {
+        dst_array_type dst;
+        cwise_max(_a, _b, dst);
+        return dst;
+    }
+
+    static inline void cwise_max(const src_array_type &_src,
+                                 dst_array_type &_dst)
+    {
+        cwise_max(_src, _dst, _dst);
+    }
+
+    static inline void cwise_max(const src_array_type &_a,
+                                 const src_array_type &_b,
+                                 dst_array_type &_dst)
+    {
+        if(!vectorize) {
+            scalar_type::cwise_max(_a, _b, _dst);
+            return;
+        }
+        vector_type::max(vector_type::load(_a), vector_type::load(_b)).store(_dst);
+    }
+};
 }
 #endif // INDEX_HPP
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <array>
+
+namespace kdtree {
+
+/// Index traits declare wrapping dimensions by
+///     static constexpr int period(std::size_t dim)
+/// returning the number of cells per turn, or 0 for a dimension that does
+/// not wrap. Indices of a periodic dimension have to lie in [0, period),
+/// neighbours across the border are then wrapped into that range. A period
+/// of at most 2 * radius of the neighbourhood would make a cell its own or
+/// a double neighbour, see periods_above.
+
+/// traits without periodic dimensions, e.g. as default argument
+struct IndexNotPeriodic {
+};
+
+template<typename ITraits, typename Enable = void>
+struct IndexPeriods {
+    static constexpr bool periodic = false;
+
+    static constexpr int period(const std::size_t)
+    {
+        return 0;
+    }
+
+    template<typename Index>
+    static inline void wrap(Index *, Index *)
+    {
+    }
+};
+
+template<typename ITraits>
+struct IndexPeriods<ITraits, decltype(ITraits::period(0), void())> {
+    static constexpr bool periodic = true;
+
+    static constexpr int period(const std::size_t _dim)
+    {
+        return ITraits::period(_dim);
+    }
+
+    /// neighbour indices are at most one period off
+    template<typename Index>
+    static inline void wrap(Index *_begin, Index *_end)
+    {
+        constexpr std::size_t Dim = std::tuple_size<Index>::value;
+        for(Index *index = _begin ; index != _end ; ++index) {
+            for(std::size_t i = 0 ; i < Dim ; ++i) {
+                const int p = period(i);
+                if(p == 0)
+                    continue;
+                if((*index)[i] < 0)
+                    (*index)[i] += p;
+                else if((*index)[i] >= p)
+                    (*index)[i] -= p;
+            }
+        }
+    }
+};
+
+/// true if every periodic dimension below Dim has a period above span
+template<typename ITraits>
+constexpr bool periods_above(const int _span, const std::size_t _dim, const std::size_t _end)
+{
+    return _dim == _end ||
+           ((IndexPeriods<ITraits>::period(_dim) == 0 || IndexPeriods<ITraits>::period(_dim) > _span) &&
+            periods_above<ITraits>(_span, _dim + 1, _end));
+}
+
+}
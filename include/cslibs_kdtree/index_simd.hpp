@@ -0,0 +1,219 @@
+#ifndef INDEX_SIMD_HPP
+#define INDEX_SIMD_HPP
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace kdtree {
+namespace detail
+{
+#if defined(__SSE2__)
+    /// the first Lanes ints of p in one register without touching memory behind them
+    template<std::size_t Lanes>
+    struct int_lanes;
+
+    template<>
+    struct int_lanes<1>
+    {
+        static inline __m128i load(const int* p) { return _mm_cvtsi32_si128(p[0]); }
+        static inline void store(int* p, __m128i v) { p[0] = _mm_cvtsi128_si32(v); }
+    };
+
+    template<>
+    struct int_lanes<2>
+    {
+        static inline __m128i load(const int* p) { return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)); }
+        static inline void store(int* p, __m128i v) { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), v); }
+    };
+
+    template<>
+    struct int_lanes<3>
+    {
+        static inline __m128i load(const int* p)
+        {
+            return _mm_unpacklo_epi64(int_lanes<2>::load(p), _mm_cvtsi32_si128(p[2]));
+        }
+
+        static inline void store(int* p, __m128i v)
+        {
+            int_lanes<2>::store(p, v);
+            p[2] = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+        }
+    };
+
+    template<>
+    struct int_lanes<4>
+    {
+        static inline __m128i load(const int* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        static inline void store(int* p, __m128i v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    };
+#endif
+
+    /// Dim int lanes in vector registers, padding lanes are zero. enabled is
+    /// false if the target has no vector unit or Dim is outside 2 to 8.
+    template<std::size_t Dim, typename Enable = void>
+    struct int_vector
+    {
+        static constexpr bool enabled = false;
+    };
+
+#if defined(__SSE2__)
+#if defined(__AVX2__)
+    static constexpr std::size_t int_vector_sse_max = 4;
+#else
+    static constexpr std::size_t int_vector_sse_max = 8;
+#endif
+
+    /// SSE2 is part of every x86-64 target, min / max use SSE4.1 if available
+    template<std::size_t Dim>
+    struct int_vector<Dim, typename std::enable_if<(Dim >= 2 && Dim <= int_vector_sse_max)>::type>
+    {
+        static constexpr bool enabled = true;
+        static constexpr std::size_t Registers = (Dim + 3) / 4;
+        typedef std::array<int, Dim> ArrayType;
+
+        __m128i r[Registers];
+
+        static inline int_vector load(const ArrayType& a)
+        {
+            int_vector v;
+            for (std::size_t i = 0; i + 1 < Registers; ++i)
+                v.r[i] = int_lanes<4>::load(a.data() + 4 * i);
+            v.r[Registers - 1] = int_lanes<Dim - 4 * (Registers - 1)>::load(a.data() + 4 * (Registers - 1));
+            return v;
+        }
+
+        inline void store(ArrayType& a) const
+        {
+            for (std::size_t i = 0; i + 1 < Registers; ++i)
+                int_lanes<4>::store(a.data() + 4 * i, r[i]);
+            int_lanes<Dim - 4 * (Registers - 1)>::store(a.data() + 4 * (Registers - 1), r[Registers - 1]);
+        }
+
+        static inline int_vector add(const int_vector& a, const int_vector& b)
+        {
+            int_vector v;
+            for (std::size_t i = 0; i < Registers; ++i)
+                v.r[i] = _mm_add_epi32(a.r[i], b.r[i]);
+            return v;
+        }
+
+        static inline int_vector sub(const int_vector& a, const int_vector& b)
+        {
+            int_vector v;
+            for (std::size_t i = 0; i < Registers; ++i)
+                v.r[i] = _mm_sub_epi32(a.r[i], b.r[i]);
+            return v;
+        }
+
+        static inline int_vector min(const int_vector& a, const int_vector& b)
+        {
+            int_vector v;
+            for (std::size_t i = 0; i < Registers; ++i)
+                v.r[i] = min(a.r[i], b.r[i]);
+            return v;
+        }
+
+        static inline int_vector max(const int_vector& a, const int_vector& b)
+        {
+            int_vector v;
+            for (std::size_t i = 0; i < Registers; ++i)
+                v.r[i] = max(a.r[i], b.r[i]);
+            return v;
+        }
+
+        static inline bool equals(const int_vector& a, const int_vector& b)
+        {
+            int mask = 0xffff;
+            for (std::size_t i = 0; i < Registers; ++i)
+                mask &= _mm_movemask_epi8(_mm_cmpeq_epi32(a.r[i], b.r[i]));
+            return mask == 0xffff;
+        }
+
+    private:
+        static inline __m128i min(__m128i a, __m128i b)
+        {
+#if defined(__SSE4_1__)
+            return _mm_min_epi32(a, b);
+#else
+            const __m128i greater = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+#endif
+        }
+
+        static inline __m128i max(__m128i a, __m128i b)
+        {
+#if defined(__SSE4_1__)
+            return _mm_max_epi32(a, b);
+#else
+            const __m128i greater = _mm_cmpgt_epi32(a, b);
+            return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+#endif
+        }
+    };
+#endif
+
+#if defined(__AVX2__)
+    /// one AVX2 register for up to 8 lanes
+    template<std::size_t Dim>
+    struct int_vector<Dim, typename std::enable_if<(Dim > 4 && Dim <= 8)>::type>
+    {
+        static constexpr bool enabled = true;
+        typedef std::array<int, Dim> ArrayType;
+
+        __m256i r;
+
+        static inline int_vector load(const ArrayType& a)
+        {
+            const __m128i low = int_lanes<4>::load(a.data());
+            const __m128i high = int_lanes<Dim - 4>::load(a.data() + 4);
+            return int_vector{_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1)};
+        }
+
+        inline void store(ArrayType& a) const
+        {
+            int_lanes<4>::store(a.data(), _mm256_castsi256_si128(r));
+            int_lanes<Dim - 4>::store(a.data() + 4, _mm256_extracti128_si256(r, 1));
+        }
+
+        static inline int_vector add(const int_vector& a, const int_vector& b)
+        {
+            return int_vector{_mm256_add_epi32(a.r, b.r)};
+        }
+
+        static inline int_vector sub(const int_vector& a, const int_vector& b)
+        {
+            return int_vector{_mm256_sub_epi32(a.r, b.r)};
+        }
+
+        static inline int_vector min(const int_vector& a, const int_vector& b)
+        {
+            return int_vector{_mm256_min_epi32(a.r, b.r)};
+        }
+
+        static inline int_vector max(const int_vector& a, const int_vector& b)
+        {
+            return int_vector{_mm256_max_epi32(a.r, b.r)};
+        }
+
+        static inline bool equals(const int_vector& a, const int_vector& b)
+        {
+            return _mm256_movemask_epi8(_mm256_cmpeq_epi32(a.r, b.r)) == -1;
+        }
+    };
+#endif
+}
+}
+
+#endif // INDEX_SIMD_HPP
@@ -2,8 +2,15 @@
 
 #include "kdtree_buffered.hpp"
 #include "kdtree_unbuffered.hpp"
+#include "kdtree_compact.hpp"
+#include "kdtree_hashed.hpp"
+#include "kdtree_morton.hpp"
 #include "kdtree_node.hpp"
 #include "kdtree_clustering.hpp"
+#include "kdtree_grid_clustering.hpp"
+#include "kdtree_incremental_clustering.hpp"
+#include "kdtree_statistics.hpp"
+#include "kdtree_decay.hpp"
 
 namespace kdtree
 {
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace kdtree
+{
+
+/// Builds a balanced tree from a set of unique cells at once. Every range
+/// is split at the median of its widest dimension, so leaf depths differ
+/// by at most a few levels regardless of the insertion order.
+template<typename NodeT>
+class KDTreeBalancedBuild
+{
+public:
+    typedef NodeT                                   NodeType;
+    typedef typename NodeType::IndexType            IndexType;
+    typedef typename NodeType::IndexPivotType       IndexPivotType;
+    typedef typename NodeType::DataType             DataType;
+    typedef typename IndexType::value_type          IndexValueType;
+    typedef std::pair<IndexType, DataType>          EntryType;
+    typedef std::vector<EntryType>                  EntriesType;
+    typedef typename EntriesType::iterator          EntryIterator;
+
+    static constexpr std::size_t IndexDimension = NodeType::IndexDimension;
+
+    /// allocate() has to return a cleared node, nodes are requested in pre-order
+    template<typename Allocate>
+    static inline NodeType* build(EntriesType& entries, Allocate&& allocate)
+    {
+        if (entries.empty())
+            return nullptr;
+
+        return build(entries.begin(), entries.end(), allocate);
+    }
+
+    /// splits [begin, end) of at least two unique cells at the median of the widest dimension,
+    /// the returned iterator starts the upper half, left_max / right_min bound the gap between halves
+    static inline EntryIterator partition(EntryIterator begin, EntryIterator end,
+                                          std::size_t& pivot_index,
+                                          IndexValueType& left_max,
+                                          IndexValueType& right_min)
+    {
+        pivot_index = widest_dimension(begin, end);
+        const std::size_t d = pivot_index;
+        auto less = [d](const EntryType& a, const EntryType& b)
+        {
+            return a.first[d] < b.first[d];
+        };
+
+        EntryIterator median = begin + (end - begin) / 2;
+        std::nth_element(begin, median, end, less);
+        const IndexValueType median_value = median->first[d];
+
+        /// cells equal to the median go to the side that keeps both halves closer in size
+        EntryIterator lower = std::partition(begin, end, [d, median_value](const EntryType& e)
+        {
+            return e.first[d] < median_value;
+        });
+        EntryIterator upper = std::partition(lower, end, [d, median_value](const EntryType& e)
+        {
+            return e.first[d] == median_value;
+        });
+        EntryIterator split = upper;
+        if (upper == end || (lower != begin && median - lower < upper - median))
+            split = lower;
+
+        left_max = std::max_element(begin, split, less)->first[d];
+        right_min = std::min_element(split, end, less)->first[d];
+        return split;
+    }
+
+private:
+    template<typename Allocate>
+    static inline NodeType* build(EntryIterator begin, EntryIterator end, Allocate& allocate)
+    {
+        NodeType* node = allocate();
+        if (end - begin == 1)
+        {
+            node->clear();
+            node->index = std::move(begin->first);
+            node->data = std::move(begin->second);
+            return node;
+        }
+
+        std::size_t pivot_index;
+        IndexValueType left_max;
+        IndexValueType right_min;
+        EntryIterator split = partition(begin, end, pivot_index, left_max, right_min);
+        const IndexPivotType pivot_value = (left_max + right_min) / IndexPivotType(2.0);
+
+        NodeType* left = build(begin, split, allocate);
+        NodeType* right = build(split, end, allocate);
+        node->split(left, right, pivot_index, pivot_value);
+        return node;
+    }
+
+    static inline std::size_t widest_dimension(EntryIterator begin, EntryIterator end)
+    {
+        IndexType min = begin->first;
+        IndexType max = begin->first;
+        for (EntryIterator it = begin + 1; it != end; ++it)
+        {
+            for (std::size_t i = 0; i < IndexDimension; ++i)
+            {
+                min[i] = std::min(min[i], it->first[i]);
+                max[i] = std::max(max[i], it->first[i]);
+            }
+        }
+
+        std::size_t widest = 0;
+        for (std::size_t i = 1; i < IndexDimension; ++i)
+            if (max[i] - min[i] > max[widest] - min[widest])
+                widest = i;
+        return widest;
+    }
+};
+
+}
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
-#include <stdexcept>
+#include "chunk_buffer.hpp"
 #include "kdtree_node.hpp"
+#include "flat_hash_map.hpp"
+#include "kdtree_balanced_build.hpp"
+#include "kdtree_shared_descent.hpp"
+#include "kdtree_nearest.hpp"
+#include "kdtree_range.hpp"
 
 namespace kdtree
 {
@@ -19,8 +23,16 @@ public:
     typedef DType                             DataType;
     typedef KDTree<IndexTraits, DataType>     TreeType;
     typedef KDTreeNode<IndexTraits, DataType> NodeType;
+    typedef KDTreeBalancedBuild<NodeType>     NodeBuild;
+    typedef typename NodeBuild::EntryType     EntryType;
+    typedef KDTreeSharedDescent<NodeType*, IndexType> SharedDescent;
+    typedef typename SharedDescent::StackType FindStackType;
+    typedef KDTreeNearest<NodeType>           Nearest;
+    typedef typename Nearest::ResultType      KnnResultType;
+    typedef KDTreeRange<NodeType>             Range;
 
     static constexpr std::size_t DEFAULT_CAPACITY       = 320 * 240;
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE     = 4096;
     static constexpr std::size_t DEFAULT_BULK_BUCKETS   = 1024;
 
     static_assert(std::is_default_constructible<DataType>::value,   "DataType not default constructible");
@@ -29,12 +41,14 @@ public:
     static_assert(std::is_move_assignable<IndexType>::value,        "IndexType not move assignable");
 
 public:
-    KDTree(std::size_t capacity = DEFAULT_CAPACITY) :
-        _capacity(std::max<std::size_t>(1, capacity)),
+    /// capacity is only the initial reservation, node storage grows in chunks of chunk_size
+    KDTree(std::size_t capacity = DEFAULT_CAPACITY,
+           std::size_t chunk_size = DEFAULT_CHUNK_SIZE) :
         _size(0),
-        _nodes(_capacity),
+        _nodes(chunk_size),
         _bulkload_buffer(DEFAULT_BULK_BUCKETS)
     {
+        _nodes.reserve(std::max<std::size_t>(1, capacity));
     }
 
     /// disallow copy
@@ -43,8 +57,7 @@ public:
 
     inline void clear()
     {
-        for (std::size_t i = 0; i < _size; ++i)
-            _nodes[i].clear();
+        _nodes.for_each(_size, [](NodeType& node) { node.clear(); });
         _size = 0;
     }
 
@@ -59,27 +72,39 @@ public:
         }
         else
         {
-            if (_size + 2 >= _capacity)
-                throw std::length_error("Capacity to small, resize not yet implemented");
-
+            _nodes.reserve(_size + 2);
             sicker_insert(&(_nodes[0]), std::move(index), std::move(data));
         }
     }
 
     inline void insert_bulk(IndexType index, DataType data)
     {
-        auto find = _bulkload_buffer.find(index);
-        if (find != _bulkload_buffer.end())
-            find->second.merge(std::move(data));
-        else
-            _bulkload_buffer.emplace(std::move(index), std::move(data));
+        auto entry = _bulkload_buffer.emplace(std::move(index), std::move(data));
+        if (!entry.second)
+            entry.first->merge(std::move(data));
     }
 
+    /// an empty tree is built balanced from the buffer, otherwise the cells are inserted
     inline void load_bulk()
     {
-        for (std::pair<IndexType, DataType>&& pair : _bulkload_buffer)
-            insert(std::move(pair.first), std::move(pair.second));
+        if (_size > 0)
+        {
+            for (auto& pair : _bulkload_buffer)
+                insert(std::move(pair.first), std::move(pair.second));
+
+            _bulkload_buffer.clear();
+            return;
+        }
+
+        if (_bulkload_buffer.empty())
+            return;
 
+        typename NodeBuild::EntriesType& entries = _bulkload_buffer.entries();
+        _nodes.reserve(2 * entries.size() - 1);
+        NodeBuild::build(entries, [this]()
+        {
+            return &(_nodes[_size++]);
+        });
         _bulkload_buffer.clear();
     }
 
@@ -96,24 +121,112 @@ public:
         return sicker_find(&(_nodes[0]), index);
     }
 
-    template<typename F>
-    inline void traverse_leafs(F&& fun)
+    /// removes the cell at index, its parent is replaced by the sibling and
+    /// the last two nodes move into the freed slots to keep the storage dense
+    inline bool erase(const IndexType& index)
+    {
+        if (_size == 0)
+            return false;
+
+        NodeType* parent = nullptr;
+        NodeType* node = &(_nodes[0]);
+        while (!node->is_leaf())
+        {
+            parent = node;
+            node = node->child(index);
+        }
+
+        if (!node->equals(index))
+            return false;
+
+        if (parent == nullptr)
+        {
+            node->clear();
+            _size = 0;
+            return true;
+        }
+
+        NodeType* sibling = parent->left == node ? parent->right : parent->left;
+        parent->collapse(*sibling);
+        compact(node, sibling);
+        return true;
+    }
+
+    /// erases every leaf for which pred(NodeType&) holds, returns the number erased
+    template<typename Pred>
+    inline std::size_t erase_if(Pred&& pred)
     {
-        for (std::size_t i = 0; i < _size; ++i)
+        _erase.clear();
+        traverse_leafs([this, &pred](NodeType& node)
         {
-            NodeType& node = _nodes[i];
-            if (!node.is_leaf())
-                continue;
+            if (pred(node))
+                _erase.push_back(node.index);
+        });
+
+        for (const IndexType& index : _erase)
+            erase(index);
+        return _erase.size();
+    }
 
-            fun(node);
+    /// the k cells closest to query, nearest first as pairs of squared distance
+    /// and leaf, result is reused between calls
+    inline void knn(const IndexType& query, std::size_t k, KnnResultType& result)
+    {
+        if (_size == 0)
+        {
+            result.clear();
+            return;
         }
+
+        Nearest::knn(&(_nodes[0]), query, k, _knn_stack, result);
+    }
+
+    /// calls fun(NodeType&) for every cell with min <= index <= max, only
+    /// subtrees overlapping the box are entered
+    template<typename F>
+    inline void query_box(const IndexType& min, const IndexType& max, F&& fun)
+    {
+        if (_size > 0)
+            Range::box(&(_nodes[0]), min, max, _range_stack, fun);
+    }
+
+    /// calls fun(NodeType&) for every cell within index distance radius of center
+    template<typename F>
+    inline void query_radius(const IndexType& center, double radius, F&& fun)
+    {
+        if (_size > 0)
+            Range::radius(&(_nodes[0]), center, radius, _range_stack, fun);
+    }
+
+    /// answers the queries in [begin, end) in one descent that only branches
+    /// where a pivot separates them, fun is called for every leaf found.
+    /// The queries get reordered, stack is scratch space of the caller.
+    template<typename F>
+    inline void find_each(IndexType* begin, IndexType* end, FindStackType& stack, F&& fun)
+    {
+        if (_size == 0)
+            return;
+
+        SharedDescent::find_each(&(_nodes[0]), begin, end, stack,
+                                 [](NodeType* node) { return node->is_leaf() ? node : nullptr; },
+                                 [](NodeType* node) -> const NodeType& { return *node; },
+                                 fun);
+    }
+
+    template<typename F>
+    inline void traverse_leafs(F&& fun)
+    {
+        _nodes.for_each(_size, [&fun](NodeType& node)
+        {
+            if (node.is_leaf())
+                fun(node);
+        });
     }
 
     template<typename F>
     inline void traverse_nodes(F&& fun)
     {
-        for (std::size_t i = 0; i < _size; ++i)
-            fun(_nodes[i]);
+        _nodes.for_each(_size, fun);
     }
 
     inline const NodeType* get_root() const
@@ -127,51 +240,80 @@ public:
 private:
     inline void sicker_insert(NodeType* node, IndexType&& index, DataType&& data)
     {
-        if (node->is_leaf())
-        {
-            if (node->equals(index))
-                node->merge(std::move(data));
-            else
-            {
-                node->split(&(_nodes[_size + 0]), &(_nodes[_size + 1]), std::move(index), std::move(data));
-                _size += 2;
-            }
-        }
+        while (!node->is_leaf())
+            node = node->child(index);
+
+        if (node->equals(index))
+            node->merge(std::move(data));
         else
         {
-            if (node->check_split(index))
-                sicker_insert(node->left, std::move(index), std::move(data));
-            else
-                sicker_insert(node->right, std::move(index), std::move(data));
+            node->split(&(_nodes[_size + 0]), &(_nodes[_size + 1]), std::move(index), std::move(data));
+            _size += 2;
         }
     }
 
     inline NodeType* sicker_find(NodeType* node, const IndexType& index)
     {
-        if (node == nullptr)
-            return nullptr;
+        while (!node->is_leaf())
+            node = node->child(index);
+
+        return node->equals(index) ? node : nullptr;
+    }
+
+    /// fills the slots a and b with the last two nodes, which are cleared afterwards
+    inline void compact(NodeType* a, NodeType* b)
+    {
+        NodeType* last[2] = {&(_nodes[_size - 1]), &(_nodes[_size - 2])};
+        _size -= 2;
 
-        if (node->is_leaf())
+        NodeType* holes[2];
+        NodeType* tails[2];
+        std::size_t moves = 0;
+        std::size_t tail_count = 0;
+        for (NodeType* hole : {a, b})
         {
-            if (node->equals(index))
-                return node;
-            else
-                return nullptr;
+            if (hole != last[0] && hole != last[1])
+                holes[moves++] = hole;
         }
-        else
+        for (NodeType* tail : last)
         {
-            if (node->check_split(index))
-                return sicker_find(node->left, index);
-            else
-                return sicker_find(node->right, index);
+            if (tail != a && tail != b)
+                tails[tail_count++] = tail;
         }
+
+        for (std::size_t i = 0; i < moves; ++i)
+            relocate(tails[i], holes[i]);
+
+        last[0]->clear();
+        last[1]->clear();
+    }
+
+    /// moves a node below the root and points its parent to the new slot,
+    /// the parent is found descending towards a leaf of the moved subtree
+    inline void relocate(NodeType* from, NodeType* to)
+    {
+        const NodeType* leaf = from;
+        while (!leaf->is_leaf())
+            leaf = leaf->left;
+
+        NodeType* parent = &(_nodes[0]);
+        while (parent->left != from && parent->right != from)
+            parent = parent->child(leaf->index);
+
+        if (parent->left == from)
+            parent->left = to;
+        else
+            parent->right = to;
+        *to = std::move(*from);
     }
 
 private:
-    std::size_t _capacity;
     std::size_t _size;
-    std::vector<NodeType> _nodes;
-    std::unordered_map<IndexType, DataType> _bulkload_buffer;
+    ChunkBuffer<NodeType> _nodes;
+    std::vector<IndexType> _erase;
+    typename Nearest::StackType _knn_stack;
+    typename Range::StackType   _range_stack;
+    FlatHashMap<IndexType, DataType>        _bulkload_buffer;
 };
 
 }
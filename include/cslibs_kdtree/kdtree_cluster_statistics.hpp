@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+
+namespace kdtree
+{
+
+/// Per cluster accumulators filled by KDTreeClustering::cluster(statistics)
+/// while it floods. A statistics type provides
+///     clear()                              before the first cluster,
+///     add_cluster()                        appending the row of the next cluster id,
+///     add(std::size_t cluster, const NodeType& node)  for every labelled leaf.
+/// Rows are meant to be stored as struct of arrays indexed by cluster id.
+
+/// gathers nothing, calls to it compile away
+struct KDTreeClusterNoStatistics
+{
+    inline void clear()
+    {
+    }
+
+    inline void add_cluster()
+    {
+    }
+
+    template<typename NodeType>
+    inline void add(std::size_t, const NodeType&)
+    {
+    }
+};
+
+/// Cell count, weight sum, weighted mean and covariance of every cluster.
+/// Sample(const NodeType&, PositionType& position) writes the position of
+/// a cell and returns its weight. Sums are kept per column, mean() and
+/// covariance() are derived from them on request.
+template<std::size_t Dim, typename Sample>
+class KDTreeClusterMoments
+{
+public:
+    typedef std::array<double, Dim>         PositionType;
+    typedef std::array<double, Dim * Dim>   CovarianceType;
+
+    KDTreeClusterMoments(Sample sample = Sample()) :
+        _sample(std::move(sample))
+    {
+    }
+
+    inline void clear()
+    {
+        cells.clear();
+        weights.clear();
+        sums.clear();
+        squares.clear();
+    }
+
+    inline void add_cluster()
+    {
+        cells.push_back(0);
+        weights.push_back(0.0);
+        sums.emplace_back();
+        sums.back().fill(0.0);
+        squares.emplace_back();
+        squares.back().fill(0.0);
+    }
+
+    template<typename NodeType>
+    inline void add(std::size_t cluster, const NodeType& node)
+    {
+        PositionType position;
+        const double weight = _sample(node, position);
+
+        ++cells[cluster];
+        weights[cluster] += weight;
+        PositionType& sum = sums[cluster];
+        CovarianceType& square = squares[cluster];
+        for (std::size_t i = 0; i < Dim; ++i)
+        {
+            const double weighted = weight * position[i];
+            sum[i] += weighted;
+            for (std::size_t j = 0; j < Dim; ++j)
+                square[i * Dim + j] += weighted * position[j];
+        }
+    }
+
+    inline std::size_t size() const
+    {
+        return cells.size();
+    }
+
+    inline PositionType mean(std::size_t cluster) const
+    {
+        PositionType result;
+        for (std::size_t i = 0; i < Dim; ++i)
+            result[i] = sums[cluster][i] / weights[cluster];
+        return result;
+    }
+
+    /// weighted covariance normalised by the weight sum, row major
+    inline CovarianceType covariance(std::size_t cluster) const
+    {
+        const PositionType mu = mean(cluster);
+        CovarianceType result;
+        for (std::size_t i = 0; i < Dim; ++i)
+            for (std::size_t j = 0; j < Dim; ++j)
+                result[i * Dim + j] = squares[cluster][i * Dim + j] / weights[cluster] - mu[i] * mu[j];
+        return result;
+    }
+
+public:
+    std::vector<std::size_t>    cells;
+    std::vector<double>         weights;
+    std::vector<PositionType>   sums;       /// weighted position sums
+    std::vector<CovarianceType> squares;    /// weighted outer product sums
+
+private:
+    Sample _sample;
+};
+
+}
@@ -2,7 +2,12 @@
 
 #include <functional>
 #include <type_traits>
+#include <vector>
+#include <thread>
+#include <algorithm>
 #include "kdtree_node_neighbourhood.hpp"
+#include "concurrent_union_find.hpp"
+#include "kdtree_cluster_statistics.hpp"
 
 namespace kdtree
 {
@@ -12,47 +17,87 @@ struct KDTreeNodeClusteringSupport
     int cluster = -1;
 };
 
-template<typename TreeType>
+/// predicate accepting every cell, calls to it compile away
+struct KDTreeClusteringAccept
+{
+    template<typename... Args>
+    inline constexpr bool operator()(const Args&...) const
+    {
+        return true;
+    }
+};
+
+/// ClusterInit(const DataType&) decides if a leaf may seed a cluster,
+/// ClusterExtend(const DataType& node, const DataType& neighbour) if a
+/// cluster grows into a neighbour. The defaults are std::function accepting
+/// every cell, exchangeable through set_cluster_*. Both are called in the
+/// innermost loops and get inlined when passed as concrete types, see
+/// KDTreeClusteringStatic.
+/// Connectivity selects the neighbourhood mask, see connectivity.hpp.
+template<typename TreeType,
+         typename ClusterInit = std::function<bool(const typename TreeType::DataType&)>,
+         typename ClusterExtend = std::function<bool(const typename TreeType::DataType&,
+                                                     const typename TreeType::DataType&)>,
+         typename Connectivity = ConnectivityFull>
 class KDTreeClustering
 {
 public:
     typedef TreeType                            KDTreeType;
-    typedef KDTreeClustering<TreeType>          ClusteringType;
+    typedef KDTreeClustering<TreeType, ClusterInit, ClusterExtend, Connectivity> ClusteringType;
     typedef typename KDTreeType::NodeType       NodeType;
     typedef typename KDTreeType::DataType       DataType;
     typedef typename KDTreeType::IndexTraits    IndexTraits;
     typedef typename KDTreeType::IndexType      IndexType;
+    typedef ClusterInit                         ClusterInitType;
+    typedef ClusterExtend                       ClusterExtendType;
+    typedef KDTreeIndexNeigbourhood<TreeType, IndexTraits, Connectivity> NeighbourhoodType;
 
     static_assert(std::is_base_of<KDTreeNodeClusteringSupport, DataType>::value,
                   "NodeType does not have KDTreeNodeClusteringSupport");
 
 public:
-    KDTreeClustering(KDTreeType& tree) :
+    KDTreeClustering(KDTreeType& tree,
+                     ClusterInit cluster_init = ClusterInit(KDTreeClusteringAccept()),
+                     ClusterExtend cluster_extend = ClusterExtend(KDTreeClusteringAccept())) :
         _tree(tree),
         _cluster_count(0),
         _neighbourhood(tree),
-        _cluster_init(&KDTreeClustering::nop1),
-        _cluster_extend(&KDTreeClustering::nop2)
+        _cluster_init(std::move(cluster_init)),
+        _cluster_extend(std::move(cluster_extend))
     {
     }
 
+    /// runtime predicates need assignable predicate types, e.g. the std::function defaults
     template<typename F>
     inline void set_cluster_init(const F& fun)
     {
+        static_assert(std::is_assignable<ClusterInit&, const F&>::value,
+                      "ClusterInit cannot be assigned, use the default predicate types for runtime predicates");
         _cluster_init = fun;
     }
 
     template<typename F>
     inline void set_cluster_extend(const F& fun)
     {
+        static_assert(std::is_assignable<ClusterExtend&, const F&>::value,
+                      "ClusterExtend cannot be assigned, use the default predicate types for runtime predicates");
         _cluster_extend = fun;
     }
 
     inline void cluster()
+    {
+        KDTreeClusterNoStatistics statistics;
+        cluster(statistics);
+    }
+
+    /// clusters and fills statistics with one row per cluster id in the same pass
+    template<typename Statistics>
+    inline void cluster(Statistics& statistics)
     {
         int cluster_idx = 0;
+        statistics.clear();
 
-        _tree.traverse_leafs([this, &cluster_idx](NodeType& node)
+        _tree.traverse_leafs([this, &cluster_idx, &statistics](NodeType& node)
         {
             if (node.data.cluster > -1)
                 return;
@@ -62,9 +107,72 @@ public:
 
             node.data.cluster = cluster_idx;
             ++cluster_idx;
-            cluster(node);
+            statistics.add_cluster();
+            flood(node, statistics);
+        });
+
+        _cluster_count = cluster_idx;
+    }
+
+    /// Connected components over threads with a lock-free union-find. The
+    /// predicates have to be thread safe and cluster_extend symmetric, then the
+    /// partition and the cluster ids equal the ones of cluster().
+    inline void cluster_parallel(std::size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+        /// the cluster field holds the leaf position until the labels are written
+        _leafs.clear();
+        _tree.traverse_leafs([this](NodeType& node)
+        {
+            node.data.cluster = static_cast<int>(_leafs.size());
+            _leafs.push_back(&node);
         });
 
+        const std::size_t size = _leafs.size();
+        threads = std::max<std::size_t>(1, std::min(threads, size));
+        const std::size_t block = (size + threads - 1) / threads;
+        _sets.reset(size);
+
+        auto unite = [this, size, block](std::size_t t)
+        {
+            NeighbourhoodType neighbourhood(_tree);
+            const std::size_t end = std::min(size, (t + 1) * block);
+            for (std::size_t i = t * block; i < end; ++i)
+            {
+                NodeType& node = *_leafs[i];
+                neighbourhood.visit_half(node.index, [this, i, &node](NodeType& neighbour)
+                {
+                    /// the half neighbourhood sees every pair from one side only
+                    const std::size_t j = static_cast<std::size_t>(neighbour.data.cluster);
+                    if (_cluster_extend(node.data, neighbour.data))
+                        _sets.unite(static_cast<ConcurrentUnionFind::ElementType>(i),
+                                    static_cast<ConcurrentUnionFind::ElementType>(j));
+                });
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (std::size_t t = 1; t < threads; ++t)
+            workers.emplace_back(unite, t);
+        unite(0);
+        for (std::thread& worker : workers)
+            worker.join();
+
+        /// a set is numbered at its first leaf passing cluster_init, as cluster() seeds
+        _labels.assign(size, -1);
+        int cluster_idx = 0;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            const std::size_t root = _sets.find(static_cast<ConcurrentUnionFind::ElementType>(i));
+            if (_labels[root] < 0 && _cluster_init(_leafs[i]->data))
+                _labels[root] = cluster_idx++;
+        }
+        for (std::size_t i = 0; i < size; ++i)
+            _leafs[i]->data.cluster = _labels[_sets.find(static_cast<ConcurrentUnionFind::ElementType>(i))];
+
         _cluster_count = cluster_idx;
     }
 
@@ -74,30 +182,54 @@ public:
     }
 
 private:
-    inline void cluster(NodeType& node)
+    /// depth first flood fill on the _queue work list, seed is already labelled
+    template<typename Statistics>
+    inline void flood(NodeType& seed, Statistics& statistics)
     {
-        _neighbourhood.visit(node.index, [this, &node](NodeType& neighbour)
+        const std::size_t cluster = static_cast<std::size_t>(seed.data.cluster);
+        _queue.clear();
+        _queue.push_back(&seed);
+        while (!_queue.empty())
         {
-            if (neighbour.data.cluster > -1)
-                return;
-
-            if (!_cluster_extend(node.data, neighbour.data))
-                return;
-
-            neighbour.data.cluster = node.data.cluster;
-            cluster(neighbour);
-        });
+            NodeType& node = *_queue.back();
+            _queue.pop_back();
+            statistics.add(cluster, node);
+
+            _neighbourhood.visit(node.index, [this, &node](NodeType& neighbour)
+            {
+                if (neighbour.data.cluster > -1)
+                    return;
+
+                if (!_cluster_extend(node.data, neighbour.data))
+                    return;
+
+                neighbour.data.cluster = node.data.cluster;
+                _queue.push_back(&neighbour);
+            });
+        }
     }
 
-    static inline constexpr bool nop1(const DataType&) { return true; }
-    static inline constexpr bool nop2(const DataType&, const DataType&) { return true; }
-
-
 private:
     KDTreeType& _tree;
     std::size_t _cluster_count;
-    KDTreeIndexNeigbourhood<TreeType, IndexTraits> _neighbourhood;
-    std::function<bool(const DataType&)> _cluster_init;
-    std::function<bool(const DataType&, const DataType&)> _cluster_extend;
+    NeighbourhoodType _neighbourhood;
+    ClusterInit   _cluster_init;
+    ClusterExtend _cluster_extend;
+
+    std::vector<NodeType*> _queue;
+    std::vector<NodeType*> _leafs;
+    std::vector<int>       _labels;
+    ConcurrentUnionFind    _sets;
 };
+
+/// clustering with predicates fixed at compile time, accepting every cell by default
+template<typename TreeType,
+         typename ClusterInit = KDTreeClusteringAccept,
+         typename ClusterExtend = KDTreeClusteringAccept,
+         typename Connectivity = ConnectivityFull>
+using KDTreeClusteringStatic = KDTreeClustering<TreeType, ClusterInit, ClusterExtend, Connectivity>;
+
+/// clustering with predicates exchangeable at runtime through set_cluster_*, same as the defaults
+template<typename TreeType>
+using KDTreeClusteringDynamic = KDTreeClustering<TreeType>;
 }
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <vector>
+#include <stdexcept>
+#include "chunk_buffer.hpp"
+#include "kdtree_node.hpp"
+#include "flat_hash_map.hpp"
+#include "kdtree_compact_node.hpp"
+#include "kdtree_balanced_build.hpp"
+#include "kdtree_shared_descent.hpp"
+
+namespace kdtree
+{
+namespace compact
+{
+
+/// KDTree with 16 byte inner nodes (for int indices) addressed by 32 bit
+/// references. Inner nodes are kept in one array, leafs with index and data
+/// in chunked storage, so leaf pointers returned by find() stay valid.
+template<typename ITraits, typename DType>
+class KDTree
+{
+public:
+    typedef ITraits                                 IndexTraits;
+    typedef typename ITraits::Type                  IndexType;
+    typedef DType                                   DataType;
+    typedef KDTree<IndexTraits, DataType>           TreeType;
+    typedef KDTreeCompactLeaf<IndexTraits, DataType> NodeType;
+    typedef KDTreeCompactInnerNode<IndexTraits>     InnerNodeType;
+    typedef typename InnerNodeType::ReferenceType   ReferenceType;
+    typedef typename InnerNodeType::IndexValueType  IndexValueType;
+    typedef KDTreeBalancedBuild<NodeType>           NodeBuild;
+    typedef typename NodeBuild::EntryIterator       EntryIterator;
+    typedef KDTreeSharedDescent<ReferenceType, IndexType> SharedDescent;
+    typedef typename SharedDescent::StackType       FindStackType;
+
+    static constexpr std::size_t DEFAULT_CAPACITY       = 320 * 240;
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE     = 4096;
+    static constexpr std::size_t DEFAULT_BULK_BUCKETS   = 1024;
+
+    static_assert(std::is_default_constructible<DataType>::value,   "DataType not default constructible");
+    static_assert(std::is_move_assignable<DataType>::value,         "DataType not move assignable");
+    static_assert(std::is_default_constructible<IndexType>::value,  "IndexType not default constructible");
+    static_assert(std::is_move_assignable<IndexType>::value,        "IndexType not move assignable");
+
+public:
+    /// capacity is only the initial reservation of leafs
+    KDTree(std::size_t capacity = DEFAULT_CAPACITY,
+           std::size_t chunk_size = DEFAULT_CHUNK_SIZE) :
+        _size(0),
+        _root(0),
+        _leafs(chunk_size),
+        _bulkload_buffer(DEFAULT_BULK_BUCKETS)
+    {
+        _leafs.reserve(std::max<std::size_t>(1, capacity));
+        _inner.reserve(std::max<std::size_t>(1, capacity));
+    }
+
+    /// disallow copy
+    KDTree(const KDTree&) = delete;
+    KDTree& operator=(const KDTree&) = delete;
+
+    inline void clear()
+    {
+        _inner.clear();
+        _size = 0;
+    }
+
+    inline void insert(IndexType index, DataType data)
+    {
+        if (_size == 0)
+        {
+            _root = add_leaf(std::move(index), std::move(data));
+            return;
+        }
+
+        ReferenceType reference = _root;
+        std::size_t parent = NO_PARENT;
+        bool right = false;
+        while (!InnerNodeType::is_leaf(reference))
+        {
+            const InnerNodeType& node = _inner[reference];
+            parent = reference;
+            right = !node.check_split(index);
+            reference = right ? node.right : node.left;
+        }
+
+        NodeType& leaf = _leafs[InnerNodeType::leaf_position(reference)];
+        if (leaf.equals(index))
+        {
+            leaf.merge(std::move(data));
+            return;
+        }
+
+        const std::size_t pivot_index = InnerNodeType::split_dimension(leaf.index, index);
+        const bool leaf_left = leaf.index[pivot_index] < index[pivot_index];
+        const typename InnerNodeType::PivotType pivot_value = leaf_left ?
+                    InnerNodeType::pivot_between(leaf.index[pivot_index], index[pivot_index]) :
+                    InnerNodeType::pivot_between(index[pivot_index], leaf.index[pivot_index]);
+
+        const ReferenceType inserted = add_leaf(std::move(index), std::move(data));
+        const ReferenceType inner = add_inner(leaf_left ? reference : inserted,
+                                              leaf_left ? inserted : reference,
+                                              pivot_index, pivot_value);
+        link(parent, right, inner);
+    }
+
+    inline void insert_bulk(IndexType index, DataType data)
+    {
+        auto entry = _bulkload_buffer.emplace(std::move(index), std::move(data));
+        if (!entry.second)
+            entry.first->merge(std::move(data));
+    }
+
+    /// an empty tree is built balanced from the buffer, otherwise the cells are inserted
+    inline void load_bulk()
+    {
+        if (_size > 0)
+        {
+            for (auto& pair : _bulkload_buffer)
+                insert(std::move(pair.first), std::move(pair.second));
+
+            _bulkload_buffer.clear();
+            return;
+        }
+
+        if (_bulkload_buffer.empty())
+            return;
+
+        typename NodeBuild::EntriesType& entries = _bulkload_buffer.entries();
+        _leafs.reserve(entries.size());
+        _inner.reserve(entries.size());
+        _root = build(entries.begin(), entries.end());
+        _bulkload_buffer.clear();
+    }
+
+    inline void clear_bulk()
+    {
+        _bulkload_buffer.clear();
+    }
+
+    inline NodeType* find(const IndexType& index)
+    {
+        if (_size == 0)
+            return nullptr;
+
+        ReferenceType reference = _root;
+        while (!InnerNodeType::is_leaf(reference))
+        {
+            const InnerNodeType& node = _inner[reference];
+            if (node.check_split(index))
+                reference = node.left;
+            else
+                reference = node.right;
+        }
+
+        NodeType& leaf = _leafs[InnerNodeType::leaf_position(reference)];
+        return leaf.equals(index) ? &leaf : nullptr;
+    }
+
+    /// answers the queries in [begin, end) in one descent that only branches
+    /// where a pivot separates them, fun is called for every leaf found.
+    /// The queries get reordered, stack is scratch space of the caller.
+    template<typename F>
+    inline void find_each(IndexType* begin, IndexType* end, FindStackType& stack, F&& fun)
+    {
+        if (_size == 0)
+            return;
+
+        SharedDescent::find_each(_root, begin, end, stack,
+                                 [this](ReferenceType reference)
+                                 {
+                                     return InnerNodeType::is_leaf(reference) ? &_leafs[InnerNodeType::leaf_position(reference)]
+                                                                              : nullptr;
+                                 },
+                                 [this](ReferenceType reference) -> const InnerNodeType& { return _inner[reference]; },
+                                 fun);
+    }
+
+    template<typename F>
+    inline void traverse_leafs(F&& fun)
+    {
+        _leafs.for_each(_size, fun);
+    }
+
+    template<typename F>
+    inline void traverse_inner_nodes(F&& fun)
+    {
+        for (InnerNodeType& node : _inner)
+            fun(node);
+    }
+
+    inline std::size_t size() const
+    {
+        return _size;
+    }
+
+    inline std::size_t inner_size() const
+    {
+        return _inner.size();
+    }
+
+private:
+    static constexpr std::size_t NO_PARENT = static_cast<std::size_t>(-1);
+
+    inline ReferenceType add_leaf(IndexType&& index, DataType&& data)
+    {
+        if (_size > InnerNodeType::MAX_REFERENCE)
+            throw std::length_error("Leaf count exceeds the compact reference range");
+
+        _leafs.reserve(_size + 1);
+        NodeType& leaf = _leafs[_size];
+        leaf.index = std::move(index);
+        leaf.data = std::move(data);
+        return InnerNodeType::leaf_reference(_size++);
+    }
+
+    inline ReferenceType add_inner(ReferenceType left, ReferenceType right,
+                                   std::size_t pivot_index,
+                                   typename InnerNodeType::PivotType pivot_value)
+    {
+        if (_inner.size() > InnerNodeType::MAX_REFERENCE)
+            throw std::length_error("Node count exceeds the compact reference range");
+
+        _inner.emplace_back(left, right, pivot_index, pivot_value);
+        return static_cast<ReferenceType>(_inner.size() - 1);
+    }
+
+    inline void link(std::size_t parent, bool right, ReferenceType child)
+    {
+        if (parent == NO_PARENT)
+            _root = child;
+        else if (right)
+            _inner[parent].right = child;
+        else
+            _inner[parent].left = child;
+    }
+
+    inline ReferenceType build(EntryIterator begin, EntryIterator end)
+    {
+        if (end - begin == 1)
+            return add_leaf(std::move(begin->first), std::move(begin->second));
+
+        std::size_t pivot_index;
+        IndexValueType left_max;
+        IndexValueType right_min;
+        EntryIterator split = NodeBuild::partition(begin, end, pivot_index, left_max, right_min);
+
+        const ReferenceType left = build(begin, split);
+        const ReferenceType right = build(split, end);
+        return add_inner(left, right, pivot_index, InnerNodeType::pivot_between(left_max, right_min));
+    }
+
+private:
+    std::size_t                 _size;
+    ReferenceType               _root;
+    std::vector<InnerNodeType>  _inner;
+    ChunkBuffer<NodeType>       _leafs;
+
+    FlatHashMap<IndexType, DataType>        _bulkload_buffer;
+};
+
+}
+}
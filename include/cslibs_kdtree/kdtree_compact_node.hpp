@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+#include <array>
+
+namespace kdtree
+{
+
+/// Leaf payload of the compact tree, stored apart from the inner nodes.
+template<typename ITraits, typename DType>
+class KDTreeCompactLeaf
+{
+public:
+    typedef ITraits                                 IndexTraits;
+    typedef typename IndexTraits::Type              IndexType;
+    typedef typename IndexTraits::PivotType         IndexPivotType;
+    typedef DType                                   DataType;
+
+    static constexpr std::size_t IndexDimension = IndexTraits::Dimension;
+
+    inline constexpr bool equals(const IndexType& index) const
+    {
+        return this->index == index;
+    }
+
+    inline void merge(DataType&& data)
+    {
+        this->data.merge(std::move(data));
+    }
+
+public:
+    IndexType index;
+    DataType data;
+};
+
+/// Inner node of the compact tree. Children are 32 bit references, the top
+/// bit marks a reference into the leaf storage. Integer indices use an
+/// integer pivot (left: value < pivot), so an inner node takes 16 bytes for
+/// int indices instead of carrying the whole index and payload.
+template<typename ITraits>
+class KDTreeCompactInnerNode
+{
+public:
+    typedef ITraits                                 IndexTraits;
+    typedef typename IndexTraits::Type              IndexType;
+    typedef typename IndexType::value_type          IndexValueType;
+    typedef typename std::conditional<std::is_integral<IndexValueType>::value,
+                                      IndexValueType,
+                                      typename IndexTraits::PivotType>::type PivotType;
+    typedef std::uint32_t                           ReferenceType;
+    typedef std::uint8_t                            PivotIndexType;
+
+    static constexpr std::size_t   IndexDimension = IndexTraits::Dimension;
+    static constexpr ReferenceType LEAF_BIT       = ReferenceType(1) << 31;
+    static constexpr ReferenceType MAX_REFERENCE  = LEAF_BIT - 1;
+
+    static_assert(IndexDimension <= 256, "Dimension does not fit into the pivot index");
+
+    KDTreeCompactInnerNode() :
+        left(0),
+        right(0),
+        pivot_value(),
+        pivot_index(0)
+    {
+    }
+
+    KDTreeCompactInnerNode(ReferenceType left, ReferenceType right,
+                           std::size_t pivot_index, PivotType pivot_value) :
+        left(left),
+        right(right),
+        pivot_value(pivot_value),
+        pivot_index(static_cast<PivotIndexType>(pivot_index))
+    {
+    }
+
+    inline constexpr bool check_split(const IndexType& index) const
+    {
+        return index[pivot_index] < pivot_value;
+    }
+
+    inline constexpr ReferenceType child(const IndexType& index) const
+    {
+        return check_split(index) ? left : right;
+    }
+
+    static inline constexpr bool is_leaf(ReferenceType reference)
+    {
+        return (reference & LEAF_BIT) != 0;
+    }
+
+    static inline constexpr ReferenceType leaf_reference(std::size_t position)
+    {
+        return static_cast<ReferenceType>(position) | LEAF_BIT;
+    }
+
+    static inline constexpr std::size_t leaf_position(ReferenceType reference)
+    {
+        return reference & ~LEAF_BIT;
+    }
+
+    /// pivot halfway between lower < upper, integer pivots round up so that
+    /// value < pivot holds for the same values as with a floating point pivot
+    static inline constexpr PivotType pivot_between(IndexValueType lower, IndexValueType upper)
+    {
+        return std::is_integral<PivotType>::value ? PivotType(lower + (upper - lower + 1) / 2)
+                                                  : (lower + upper) / PivotType(2.0);
+    }
+
+    /// split of two distinct cells on their most distant dimension
+    static inline std::size_t split_dimension(const IndexType& a, const IndexType& b)
+    {
+        std::size_t pivot_index = 0;
+        IndexValueType max_delta = 0;
+        for (std::size_t i = 0; i < IndexDimension; ++i)
+        {
+            IndexValueType delta = std::abs(a[i] - b[i]);
+            if (delta > max_delta)
+            {
+                max_delta = delta;
+                pivot_index = i;
+            }
+        }
+        return pivot_index;
+    }
+
+public:
+    ReferenceType  left;
+    ReferenceType  right;
+    PivotType      pivot_value;
+    PivotIndexType pivot_index;
+};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+namespace kdtree
+{
+
+/// Multiplies the weight of every cell by factor and erases the cells whose
+/// weight falls below threshold, in one pass over the leafs. weight(DataType&)
+/// returns a reference to the merged weight of a cell, the tree has to
+/// provide erase_if. Returns the number of erased cells.
+template<typename Tree, typename Weight>
+inline std::size_t decay(Tree& tree, double factor, double threshold, Weight&& weight)
+{
+    return tree.erase_if([factor, threshold, &weight](typename Tree::NodeType& node)
+    {
+        auto& w = weight(node.data);
+        w *= factor;
+        return w < threshold;
+    });
+}
+
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <type_traits>
+#include "array.hpp"
+#include "connectivity.hpp"
+#include "index.hpp"
+#include "index_periodic.hpp"
+#include "kdtree_clustering.hpp"
+
+namespace kdtree
+{
+namespace detail
+{
+    /// true for trees tracking the bounds of their cells, e.g. unbuffered::KDTree
+    template<typename Tree, typename Enable = void>
+    struct has_index_bounds : std::false_type {};
+
+    template<typename Tree>
+    struct has_index_bounds<Tree, decltype(std::declval<const Tree&>().get_min_index(), void())> : std::true_type {};
+}
+
+/// Clustering front end choosing between a dense grid and the tree. If the
+/// bounding box of the cells holds at most grid_threshold cells, the leafs
+/// are written into an Array and flood filled there, neighbours are then a
+/// direct lookup instead of a tree query. Otherwise KDTreeClustering runs.
+/// Both paths seed clusters in leaf traversal order, so for a symmetric
+/// ClusterExtend they label the cells identically.
+template<typename TreeType,
+         typename ClusterInit = KDTreeClusteringAccept,
+         typename ClusterExtend = KDTreeClusteringAccept,
+         typename Connectivity = ConnectivityFull>
+class KDTreeGridClustering
+{
+public:
+    typedef TreeType                                KDTreeType;
+    typedef typename KDTreeType::NodeType           NodeType;
+    typedef typename KDTreeType::DataType           DataType;
+    typedef typename KDTreeType::IndexTraits        IndexTraits;
+    typedef typename KDTreeType::IndexType          IndexType;
+    typedef typename IndexType::value_type          IndexValueType;
+    typedef KDTreeClustering<TreeType, ClusterInit, ClusterExtend, Connectivity> TreeClusteringType;
+
+    static constexpr std::size_t Dimension = IndexTraits::Dimension;
+    typedef Array<NodeType*, Dimension>             GridType;
+    typedef typename GridType::Size                 GridSize;
+    typedef typename GridType::Index                GridIndex;
+    typedef typename Connectivity::template Mask<IndexType, Dimension> MaskFiller;
+    typedef typename MaskFiller::Type               MaskType;
+    typedef ArrayOperations<Dimension, IndexValueType, IndexValueType> AO;
+    typedef IndexPeriods<IndexTraits>               Periods;
+
+    static constexpr std::size_t DEFAULT_GRID_THRESHOLD = 1 << 20;
+
+    static_assert(std::is_integral<IndexValueType>::value, "Grid clustering needs integer indices");
+
+public:
+    KDTreeGridClustering(KDTreeType& tree,
+                         ClusterInit cluster_init = ClusterInit(KDTreeClusteringAccept()),
+                         ClusterExtend cluster_extend = ClusterExtend(KDTreeClusteringAccept())) :
+        _tree(tree),
+        _tree_clustering(tree, cluster_init, cluster_extend),
+        _cluster_init(std::move(cluster_init)),
+        _cluster_extend(std::move(cluster_extend)),
+        _grid_threshold(DEFAULT_GRID_THRESHOLD),
+        _used_grid(false),
+        _cluster_count(0),
+        _grid(GridSize())
+    {
+        MaskFiller::assign(_offsets);
+    }
+
+    /// largest bounding box volume in cells clustered on the grid, 0 always uses the tree
+    inline void set_grid_threshold(std::size_t cells)
+    {
+        _grid_threshold = cells;
+    }
+
+    inline std::size_t grid_threshold() const
+    {
+        return _grid_threshold;
+    }
+
+    inline void cluster()
+    {
+        _used_grid = false;
+        _leafs.clear();
+
+        IndexType min_index;
+        IndexType max_index;
+        if (!collect(min_index, max_index))
+        {
+            _tree_clustering.cluster();
+            _cluster_count = _tree_clustering.cluster_count();
+            return;
+        }
+
+        _used_grid = true;
+        cluster_grid(min_index, max_index);
+    }
+
+    inline std::size_t cluster_count() const
+    {
+        return _cluster_count;
+    }
+
+    /// path taken by the last cluster() call
+    inline bool used_grid() const
+    {
+        return _used_grid;
+    }
+
+private:
+    /// leafs into _leafs and their bounds, false if the grid would exceed the threshold
+    template<typename Tree = TreeType>
+    inline typename std::enable_if<detail::has_index_bounds<Tree>::value, bool>::type
+    collect(IndexType& min_index, IndexType& max_index)
+    {
+        min_index = _tree.get_min_index();
+        max_index = _tree.get_max_index();
+        if (!fits(min_index, max_index))
+            return false;
+
+        _tree.traverse_leafs([this](NodeType& node) { _leafs.push_back(&node); });
+        return true;
+    }
+
+    template<typename Tree = TreeType>
+    inline typename std::enable_if<!detail::has_index_bounds<Tree>::value, bool>::type
+    collect(IndexType& min_index, IndexType& max_index)
+    {
+        min_index.fill(std::numeric_limits<IndexValueType>::max());
+        max_index.fill(std::numeric_limits<IndexValueType>::min());
+        _tree.traverse_leafs([this, &min_index, &max_index](NodeType& node)
+        {
+            AO::cwise_min(node.index, min_index);
+            AO::cwise_max(node.index, max_index);
+            _leafs.push_back(&node);
+        });
+        return fits(min_index, max_index);
+    }
+
+    inline bool fits(const IndexType& min_index, const IndexType& max_index) const
+    {
+        std::size_t cells = 1;
+        for (std::size_t i = 0; i < Dimension; ++i)
+        {
+            if (max_index[i] < min_index[i])
+                return false;
+
+            const std::size_t extent = static_cast<std::size_t>(
+                        static_cast<long long>(max_index[i]) - static_cast<long long>(min_index[i])) + 1;
+            if (extent > _grid_threshold || cells > _grid_threshold / extent)
+                return false;
+            cells *= extent;
+        }
+        return true;
+    }
+
+    inline void cluster_grid(const IndexType& min_index, const IndexType& max_index)
+    {
+        GridSize size;
+        for (std::size_t i = 0; i < Dimension; ++i)
+            size[i] = static_cast<std::size_t>(max_index[i] - min_index[i]) + 1;
+        _grid.resize(size);
+        _grid.reset(nullptr);
+
+        GridIndex position;
+        for (NodeType* node : _leafs)
+        {
+            for (std::size_t i = 0; i < Dimension; ++i)
+                position[i] = static_cast<std::size_t>(node->index[i] - min_index[i]);
+            _grid.at_unchecked(position) = node;
+        }
+
+        int cluster_idx = 0;
+        for (NodeType* node : _leafs)
+        {
+            if (node->data.cluster > -1)
+                continue;
+
+            if (!_cluster_init(node->data))
+                continue;
+
+            node->data.cluster = cluster_idx;
+            ++cluster_idx;
+            flood_fill(*node, min_index, max_index);
+        }
+        _cluster_count = cluster_idx;
+    }
+
+    /// depth first on the _queue work list, seed is already labelled
+    inline void flood_fill(NodeType& seed, const IndexType& min_index, const IndexType& max_index)
+    {
+        GridIndex position;
+        _queue.clear();
+        _queue.push_back(&seed);
+        while (!_queue.empty())
+        {
+            NodeType& node = *_queue.back();
+            _queue.pop_back();
+
+            AO::add_each(node.index, _offsets.data(), _neighbours.data(), _offsets.size());
+            Periods::wrap(_neighbours.data(), _neighbours.data() + _neighbours.size());
+            for (const IndexType& index : _neighbours)
+            {
+                bool out_of_bounds = false;
+                for (std::size_t i = 0; i < Dimension; ++i)
+                {
+                    out_of_bounds |= index[i] < min_index[i];
+                    out_of_bounds |= index[i] > max_index[i];
+                    position[i] = static_cast<std::size_t>(index[i] - min_index[i]);
+                }
+                if (out_of_bounds)
+                    continue;
+
+                NodeType* neighbour = _grid.at_unchecked(position);
+                if (neighbour == nullptr || neighbour->data.cluster > -1)
+                    continue;
+
+                if (!_cluster_extend(node.data, neighbour->data))
+                    continue;
+
+                neighbour->data.cluster = node.data.cluster;
+                _queue.push_back(neighbour);
+            }
+        }
+    }
+
+private:
+    KDTreeType&         _tree;
+    TreeClusteringType  _tree_clustering;
+    ClusterInit         _cluster_init;
+    ClusterExtend       _cluster_extend;
+
+    std::size_t         _grid_threshold;
+    bool                _used_grid;
+    std::size_t         _cluster_count;
+
+    GridType               _grid;
+    MaskType               _offsets;
+    MaskType               _neighbours;
+    std::vector<NodeType*> _leafs;
+    std::vector<NodeType*> _queue;
+};
+
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "chunk_buffer.hpp"
+#include "kdtree_node.hpp"
+#include "kdtree_compact_node.hpp"
+#include "flat_hash_map.hpp"
+
+namespace kdtree
+{
+namespace hashed
+{
+
+/// Cells in a spatial hash behind the KDTree interface. find() is a single
+/// hash probe instead of a descent, which pays off for sparse integer
+/// indices. There is no hierarchy, get_root() is always nullptr and every
+/// node is a leaf. Cells are kept in chunked storage, so pointers returned by
+/// find() stay valid.
+template<typename ITraits, typename DType>
+class KDTree
+{
+public:
+    typedef ITraits                                 IndexTraits;
+    typedef typename ITraits::Type                  IndexType;
+    typedef DType                                   DataType;
+    typedef KDTree<IndexTraits, DataType>           TreeType;
+    typedef KDTreeCompactLeaf<IndexTraits, DataType> NodeType;
+    typedef FlatHashMap<IndexType, std::size_t>     LookupType;
+
+    /// no descent to share, find_each() probes every query on its own
+    struct FindStackType {};
+
+    static constexpr std::size_t DEFAULT_CAPACITY       = 320 * 240;
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE     = 4096;
+    static constexpr std::size_t DEFAULT_BUCKETS        = 1024;
+    static constexpr std::size_t DEFAULT_BULK_BUCKETS   = 1024;
+
+    static_assert(std::is_default_constructible<DataType>::value,   "DataType not default constructible");
+    static_assert(std::is_move_assignable<DataType>::value,         "DataType not move assignable");
+    static_assert(std::is_default_constructible<IndexType>::value,  "IndexType not default constructible");
+    static_assert(std::is_move_assignable<IndexType>::value,        "IndexType not move assignable");
+
+public:
+    /// capacity is only the initial reservation, cell storage grows in chunks of chunk_size,
+    /// the hash table from DEFAULT_BUCKETS so that clear() stays cheap for small frames
+    KDTree(std::size_t capacity = DEFAULT_CAPACITY,
+           std::size_t chunk_size = DEFAULT_CHUNK_SIZE) :
+        _size(0),
+        _cells(chunk_size),
+        _lookup(DEFAULT_BUCKETS),
+        _bulkload_buffer(DEFAULT_BULK_BUCKETS)
+    {
+        _cells.reserve(std::max<std::size_t>(1, capacity));
+    }
+
+    /// disallow copy
+    KDTree(const KDTree&) = delete;
+    KDTree& operator=(const KDTree&) = delete;
+
+    /// cell storage and hash slots are kept for reuse
+    inline void clear()
+    {
+        _lookup.clear();
+        _size = 0;
+    }
+
+    inline void insert(IndexType index, DataType data)
+    {
+        std::size_t position = _size;
+        auto entry = _lookup.emplace(IndexType(index), std::move(position));
+        if (!entry.second)
+        {
+            _cells[*entry.first].merge(std::move(data));
+            return;
+        }
+
+        _cells.reserve(_size + 1);
+        NodeType& cell = _cells[_size];
+        cell.index = std::move(index);
+        cell.data = std::move(data);
+        ++_size;
+    }
+
+    /// staged as in the trees, the cells are not visible before load_bulk()
+    inline void insert_bulk(IndexType index, DataType data)
+    {
+        auto entry = _bulkload_buffer.emplace(std::move(index), std::move(data));
+        if (!entry.second)
+            entry.first->merge(std::move(data));
+    }
+
+    inline void load_bulk()
+    {
+        if (_bulkload_buffer.empty())
+            return;
+
+        _cells.reserve(_size + _bulkload_buffer.size());
+        for (auto& pair : _bulkload_buffer)
+            insert(std::move(pair.first), std::move(pair.second));
+        _bulkload_buffer.clear();
+    }
+
+    inline void clear_bulk()
+    {
+        _bulkload_buffer.clear();
+    }
+
+    inline NodeType* find(const IndexType& index)
+    {
+        if (_size == 0)
+            return nullptr;
+
+        const std::size_t* position = _lookup.lookup(index);
+        return position ? &_cells[*position] : nullptr;
+    }
+
+    template<typename F>
+    inline void find_each(IndexType* begin, IndexType* end, FindStackType&, F&& fun)
+    {
+        for (IndexType* query = begin; query != end; ++query)
+        {
+            NodeType* node = find(*query);
+            if (node)
+                fun(*node);
+        }
+    }
+
+    template<typename F>
+    inline void traverse_leafs(F&& fun)
+    {
+        _cells.for_each(_size, fun);
+    }
+
+    template<typename F>
+    inline void traverse_nodes(F&& fun)
+    {
+        _cells.for_each(_size, fun);
+    }
+
+    inline const NodeType* get_root() const
+    {
+        return nullptr;
+    }
+
+    inline std::size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    std::size_t             _size;
+    ChunkBuffer<NodeType>   _cells;
+    LookupType              _lookup;
+
+    FlatHashMap<IndexType, DataType> _bulkload_buffer;
+};
+
+}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include "kdtree_clustering.hpp"
+#include "kdtree_node_neighbourhood.hpp"
+#include "union_find.hpp"
+
+namespace kdtree
+{
+
+/// Clustering kept up to date while cells are inserted. Every cell created
+/// through insert() becomes an element of a union-find and is united with
+/// the existing neighbours ClusterExtend accepts, so cluster_count() and
+/// cluster() are current without a pass over the tree.
+/// The cluster field of a leaf holds its union-find element instead of a
+/// label, cluster() maps it to the id of its cluster. Cluster ids are the
+/// elements of the oldest cell of each cluster and not consecutive.
+/// ClusterExtend has to be symmetric and is evaluated when a cell is
+/// created, later merges of data into the cell do not split clusters.
+template<typename TreeType,
+         typename ClusterExtend = KDTreeClusteringAccept,
+         typename Connectivity = ConnectivityFull>
+class KDTreeIncrementalClustering
+{
+public:
+    typedef TreeType                            KDTreeType;
+    typedef typename KDTreeType::NodeType       NodeType;
+    typedef typename KDTreeType::DataType       DataType;
+    typedef typename KDTreeType::IndexTraits    IndexTraits;
+    typedef typename KDTreeType::IndexType      IndexType;
+    typedef ClusterExtend                       ClusterExtendType;
+    typedef UnionFind::ElementType              ElementType;
+    typedef KDTreeIndexNeigbourhood<TreeType, IndexTraits, Connectivity> NeighbourhoodType;
+
+    static_assert(std::is_base_of<KDTreeNodeClusteringSupport, DataType>::value,
+                  "NodeType does not have KDTreeNodeClusteringSupport");
+
+public:
+    KDTreeIncrementalClustering(KDTreeType& tree,
+                                ClusterExtend cluster_extend = ClusterExtend(KDTreeClusteringAccept())) :
+        _tree(tree),
+        _neighbourhood(tree),
+        _cluster_extend(std::move(cluster_extend))
+    {
+        rebuild();
+    }
+
+    /// disallow copy
+    KDTreeIncrementalClustering(const KDTreeIncrementalClustering&) = delete;
+    KDTreeIncrementalClustering& operator=(const KDTreeIncrementalClustering&) = delete;
+
+    /// inserts into the tree, true if a new cell was created and clustered
+    inline bool insert(IndexType index, DataType data)
+    {
+        if (_tree.find(index) != nullptr)
+        {
+            _tree.insert(std::move(index), std::move(data));
+            return false;
+        }
+
+        const ElementType element = _sets.add();
+        data.cluster = static_cast<int>(element);
+        _tree.insert(index, std::move(data));
+
+        NodeType* node = _tree.find(index);
+        _neighbourhood.visit(index, [this, node, element](NodeType& neighbour)
+        {
+            if (neighbour.data.cluster < 0)
+                return;
+
+            if (_cluster_extend(node->data, neighbour.data))
+                _sets.unite(element, static_cast<ElementType>(neighbour.data.cluster));
+        });
+        return true;
+    }
+
+    /// clusters of all cells currently in the tree, e.g. after a bulk load
+    inline void rebuild()
+    {
+        _sets.clear();
+        _tree.traverse_leafs([this](NodeType& node)
+        {
+            node.data.cluster = static_cast<int>(_sets.add());
+        });
+
+        _tree.traverse_leafs([this](NodeType& node)
+        {
+            const ElementType element = static_cast<ElementType>(node.data.cluster);
+            _neighbourhood.visit_half(node.index, [this, &node, element](NodeType& neighbour)
+            {
+                if (_cluster_extend(node.data, neighbour.data))
+                    _sets.unite(element, static_cast<ElementType>(neighbour.data.cluster));
+            });
+        });
+    }
+
+    /// clears the tree and the clusters
+    inline void clear()
+    {
+        _tree.clear();
+        _sets.clear();
+    }
+
+    inline std::size_t cluster_count() const
+    {
+        return _sets.sets();
+    }
+
+    /// cluster id of a leaf, -1 for cells inserted behind the clustering
+    inline int cluster(const NodeType& node)
+    {
+        if (node.data.cluster < 0)
+            return -1;
+
+        return static_cast<int>(_sets.find(static_cast<ElementType>(node.data.cluster)));
+    }
+
+    /// cluster id of the cell at index, -1 if there is none
+    inline int cluster(const IndexType& index)
+    {
+        const NodeType* node = _tree.find(index);
+        return node ? cluster(*node) : -1;
+    }
+
+private:
+    KDTreeType&       _tree;
+    NeighbourhoodType _neighbourhood;
+    ClusterExtend     _cluster_extend;
+    UnionFind         _sets;
+};
+
+}
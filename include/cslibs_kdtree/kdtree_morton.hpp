@@ -0,0 +1,239 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "kdtree_node.hpp"
+#include "kdtree_compact_node.hpp"
+#include "flat_hash_map.hpp"
+#include "morton.hpp"
+
+namespace kdtree
+{
+namespace morton
+{
+
+/// Build-once cell index for read-mostly frames. Cells are kept in one
+/// array sorted by Morton key, find() is a binary search over the dense key
+/// array and spatial neighbours mostly lie close in memory. Keys only
+/// order the cells, equal keys of wrapped indices are told apart by the index.
+/// insert() on a loaded index shifts the cells and invalidates pointers
+/// returned by find(), bulk loading is the intended way to fill it.
+template<typename ITraits, typename DType>
+class KDTree
+{
+public:
+    typedef ITraits                                 IndexTraits;
+    typedef typename ITraits::Type                  IndexType;
+    typedef typename IndexType::value_type          IndexValueType;
+    typedef DType                                   DataType;
+    typedef KDTree<IndexTraits, DataType>           TreeType;
+    typedef KDTreeCompactLeaf<IndexTraits, DataType> NodeType;
+    typedef MortonCode<ITraits::Dimension, IndexValueType> Morton;
+    typedef typename Morton::KeyType                KeyType;
+    typedef std::pair<KeyType, IndexType*>          QueryType;
+
+    /// find_each() sorts the queries by key in here
+    typedef std::vector<QueryType>                  FindStackType;
+
+    static constexpr std::size_t DEFAULT_BULK_BUCKETS   = 1024;
+
+    static_assert(std::is_default_constructible<DataType>::value,   "DataType not default constructible");
+    static_assert(std::is_move_assignable<DataType>::value,         "DataType not move assignable");
+    static_assert(std::is_default_constructible<IndexType>::value,  "IndexType not default constructible");
+    static_assert(std::is_move_assignable<IndexType>::value,        "IndexType not move assignable");
+
+public:
+    KDTree(std::size_t capacity = 0) :
+        _bulkload_buffer(DEFAULT_BULK_BUCKETS)
+    {
+        _keys.reserve(capacity);
+        _cells.reserve(capacity);
+    }
+
+    /// disallow copy
+    KDTree(const KDTree&) = delete;
+    KDTree& operator=(const KDTree&) = delete;
+
+    /// memory is kept for the next frame
+    inline void clear()
+    {
+        _keys.clear();
+        _cells.clear();
+    }
+
+    inline void insert(IndexType index, DataType data)
+    {
+        const KeyType key = Morton::encode(index);
+        const std::size_t position = lower_bound(0, key, index);
+        if (position < _cells.size() && _cells[position].equals(index))
+        {
+            _cells[position].merge(std::move(data));
+            return;
+        }
+
+        _keys.insert(_keys.begin() + position, key);
+        _cells.insert(_cells.begin() + position, NodeType());
+        _cells[position].index = std::move(index);
+        _cells[position].data = std::move(data);
+    }
+
+    inline void insert_bulk(IndexType index, DataType data)
+    {
+        auto entry = _bulkload_buffer.emplace(std::move(index), std::move(data));
+        if (!entry.second)
+            entry.first->merge(std::move(data));
+    }
+
+    /// buffered cells are merged into the present ones and everything is sorted once
+    inline void load_bulk()
+    {
+        if (_bulkload_buffer.empty())
+            return;
+
+        const std::size_t present = _cells.size();
+        for (auto& entry : _bulkload_buffer)
+        {
+            NodeType* cell = present > 0 ? find(entry.first) : nullptr;
+            if (cell)
+            {
+                cell->merge(std::move(entry.second));
+                continue;
+            }
+
+            _cells.emplace_back();
+            _cells.back().index = std::move(entry.first);
+            _cells.back().data = std::move(entry.second);
+        }
+        _bulkload_buffer.clear();
+
+        _order.clear();
+        _order.reserve(_cells.size());
+        for (std::size_t i = 0; i < _cells.size(); ++i)
+            _order.emplace_back(Morton::encode(_cells[i].index), i);
+
+        std::sort(_order.begin(), _order.end(), [this](const OrderType& a, const OrderType& b)
+        {
+            return a.first < b.first ||
+                   (a.first == b.first && _cells[a.second].index < _cells[b.second].index);
+        });
+
+        _sorted.clear();
+        _sorted.reserve(_cells.size());
+        _keys.resize(_cells.size());
+        for (std::size_t i = 0; i < _order.size(); ++i)
+        {
+            _keys[i] = _order[i].first;
+            _sorted.emplace_back(std::move(_cells[_order[i].second]));
+        }
+        _cells.swap(_sorted);
+    }
+
+    inline void clear_bulk()
+    {
+        _bulkload_buffer.clear();
+    }
+
+    inline NodeType* find(const IndexType& index)
+    {
+        const std::size_t position = lower_bound(0, Morton::encode(index), index);
+        if (position < _cells.size() && _cells[position].equals(index))
+            return &_cells[position];
+        return nullptr;
+    }
+
+    /// queries are answered in key order, every search gallops on from the
+    /// previous hit, so a neighbourhood only touches the keys around its center
+    template<typename F>
+    inline void find_each(IndexType* begin, IndexType* end, FindStackType& queries, F&& fun)
+    {
+        if (_cells.empty())
+            return;
+
+        queries.clear();
+        for (IndexType* query = begin; query != end; ++query)
+            queries.emplace_back(Morton::encode(*query), query);
+        std::sort(queries.begin(), queries.end(), [](const QueryType& a, const QueryType& b)
+        {
+            return a.first < b.first || (a.first == b.first && *a.second < *b.second);
+        });
+
+        std::size_t position = 0;
+        for (const QueryType& query : queries)
+        {
+            position = lower_bound(position, query.first, *query.second);
+            if (position == _cells.size())
+                return;
+            if (_cells[position].equals(*query.second))
+                fun(_cells[position]);
+        }
+    }
+
+    template<typename F>
+    inline void traverse_leafs(F&& fun)
+    {
+        for (NodeType& cell : _cells)
+            fun(cell);
+    }
+
+    template<typename F>
+    inline void traverse_nodes(F&& fun)
+    {
+        traverse_leafs(fun);
+    }
+
+    /// no hierarchy, every node is a leaf
+    inline const NodeType* get_root() const
+    {
+        return nullptr;
+    }
+
+    inline std::size_t size() const
+    {
+        return _cells.size();
+    }
+
+private:
+    typedef std::pair<KeyType, std::size_t> OrderType;
+
+    /// first cell not ordered before (key, index), galloping from position on
+    inline std::size_t lower_bound(std::size_t position, KeyType key, const IndexType& index) const
+    {
+        auto before = [this, key, &index](std::size_t i)
+        {
+            return _keys[i] < key || (_keys[i] == key && _cells[i].index < index);
+        };
+
+        const std::size_t size = _keys.size();
+        std::size_t low = position;
+        std::size_t step = 1;
+        while (position < size && before(position))
+        {
+            low = position + 1;
+            position += step;
+            step *= 2;
+        }
+
+        std::size_t high = std::min(position, size);
+        while (low < high)
+        {
+            const std::size_t mid = low + (high - low) / 2;
+            if (before(mid))
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        return low;
+    }
+
+private:
+    std::vector<KeyType>        _keys;
+    std::vector<NodeType>       _cells;
+    std::vector<NodeType>       _sorted;
+    std::vector<OrderType>      _order;
+
+    FlatHashMap<IndexType, DataType>        _bulkload_buffer;
+};
+
+}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace kdtree
+{
+
+/// k nearest leafs of a KDTreeNode tree by squared euclidean distance of the
+/// indices. The descent follows the side of every pivot holding the query
+/// first and visits the other side only if the distance to its pivot plane
+/// can beat the current k-th candidate. The result doubles as a max heap
+/// of size k, so with reused containers a query allocates nothing.
+template<typename NodeT>
+class KDTreeNearest
+{
+public:
+    typedef NodeT                                   NodeType;
+    typedef typename NodeType::IndexType            IndexType;
+    typedef std::pair<double, NodeType*>            EntryType;      /// squared distance and leaf
+    typedef std::vector<EntryType>                  ResultType;
+    typedef std::vector<std::pair<NodeType*, double>> StackType;    /// subtree and its distance bound
+
+    static constexpr std::size_t IndexDimension = NodeType::IndexDimension;
+
+    /// result holds min(k, leafs) entries sorted by distance, nearest first
+    static inline void knn(NodeType* root, const IndexType& query, std::size_t k,
+                           StackType& stack, ResultType& result)
+    {
+        result.clear();
+        if (root == nullptr || k == 0)
+            return;
+
+        stack.clear();
+        stack.emplace_back(root, 0.0);
+        while (!stack.empty())
+        {
+            NodeType* node = stack.back().first;
+            const double bound = stack.back().second;
+            stack.pop_back();
+            if (result.size() == k && bound >= result.front().first)
+                continue;
+
+            while (!node->is_leaf())
+            {
+                const double delta = query[node->pivot_index] - node->pivot_value;
+                const double far_bound = std::max(bound, delta * delta);
+                NodeType* near = delta < 0.0 ? node->left : node->right;
+                NodeType* far  = delta < 0.0 ? node->right : node->left;
+                if (result.size() < k || far_bound < result.front().first)
+                    stack.emplace_back(far, far_bound);
+                node = near;
+            }
+
+            const double distance = squared_distance(node->index, query);
+            if (result.size() < k)
+            {
+                result.emplace_back(distance, node);
+                std::push_heap(result.begin(), result.end(), Less());
+            }
+            else if (distance < result.front().first)
+            {
+                std::pop_heap(result.begin(), result.end(), Less());
+                result.back() = EntryType(distance, node);
+                std::push_heap(result.begin(), result.end(), Less());
+            }
+        }
+
+        std::sort_heap(result.begin(), result.end(), Less());
+    }
+
+    static inline double squared_distance(const IndexType& a, const IndexType& b)
+    {
+        double distance = 0.0;
+        for (std::size_t i = 0; i < IndexDimension; ++i)
+        {
+            const double delta = static_cast<double>(a[i]) - static_cast<double>(b[i]);
+            distance += delta * delta;
+        }
+        return distance;
+    }
+
+private:
+    struct Less
+    {
+        inline bool operator()(const EntryType& a, const EntryType& b) const
+        {
+            return a.first < b.first;
+        }
+    };
+};
+
+}
@@ -2,23 +2,35 @@
 
 #include <cstdint>
 #include <array>
+#include <utility>
 
 namespace std
 {
+    /// every component is mixed in with a multiply and rotation, the result
+    /// is finalized with the murmur3 mixer so that sign flips and permutations
+    /// of components do not collide
     template<std::size_t N>
     struct hash<std::array<int, N>>
     {
         typedef std::array<int, N> argument_type;
         typedef std::size_t result_type;
-        static constexpr auto BITS = sizeof(result_type) * 8;
-        static constexpr auto SHIFT = BITS / N;
 
         inline result_type operator()(argument_type const& s) const
         {
-            result_type h = std::abs(s[0]);
-            for (std::size_t i = 1; i < N; ++i)
-                h ^= std::abs(s[i]) << SHIFT;
-            return h;
+            std::uint64_t h = 0x9e3779b97f4a7c15ull;
+            for (std::size_t i = 0; i < N; ++i)
+            {
+                h ^= static_cast<std::uint32_t>(s[i]);
+                h *= 0xbf58476d1ce4e5b9ull;
+                h = (h << 31) | (h >> 33);
+            }
+
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return static_cast<result_type>(h);
         }
     };
 }
@@ -69,6 +81,15 @@ public:
         return index[pivot_index] < pivot_value;
     }
 
+    /// kept a branch rather than a conditional move, consecutive queries
+    /// are spatially coherent and the dynamic predictor follows them
+    inline NodeType* child(const IndexType& index) const
+    {
+        if (check_split(index))
+            return left;
+        return right;
+    }
+
     inline void merge(DataType&& data)
     {
         this->data.merge(std::move(data));
@@ -113,6 +134,25 @@ public: /// todo: make private
         this->right = right;
     }
 
+    inline void split(NodeType* left, NodeType* right, std::size_t pivot_index, IndexPivotType pivot_value)
+    {
+        this->pivot_index = pivot_index;
+        this->pivot_value = pivot_value;
+        this->left = left;
+        this->right = right;
+    }
+
+    /// replaces this inner node by its child, used when the other child is erased
+    inline void collapse(NodeType& child)
+    {
+        left = child.left;
+        right = child.right;
+        index = child.index;
+        pivot_value = child.pivot_value;
+        pivot_index = child.pivot_index;
+        data = std::move(child.data);
+    }
+
     inline void clear()
     {
         left = nullptr;
@@ -2,51 +2,89 @@
 
 #include <cstdint>
 #include <array>
-#include "fill.hpp"
+#include "connectivity.hpp"
+#include "index.hpp"
+#include "index_periodic.hpp"
 
 namespace kdtree
 {
-template<typename Tree, typename ITraits>
+/// Visits the cells around a reference without the reference itself. All
+/// offsets are answered in one shared descent through Tree::find_each.
+/// Periodic dimensions of ITraits wrap around, see IndexPeriods. The
+/// offsets are the mask of Connectivity without the zero center.
+/// Tree has to provide
+///     typedef ... FindStackType;
+///     template<typename F>
+///     void find_each(IndexType* begin, IndexType* end, FindStackType& stack, F&& fun);
+/// The descent stack is kept between calls so that visiting does not
+/// allocate, an object must therefore not be re-entered from within fun
+/// or used by several threads at once. Use one object per thread.
+template<typename Tree, typename ITraits, typename Connectivity = ConnectivityFull>
 class KDTreeIndexNeigbourhood
 {
 public:
     typedef typename ITraits::Type              Type;
     static constexpr std::size_t Dimension = ITraits::Dimension;
-    typedef detail::fill<Type, Dimension>       MaskFiller;
+    typedef typename Connectivity::template Mask<Type, Dimension> MaskFiller;
     typedef typename MaskFiller::Type           MaskType;
+    typedef typename Tree::FindStackType        FindStackType;
+    typedef ArrayOperations<Dimension,
+                            typename Type::value_type,
+                            typename Type::value_type> AO;
+    typedef IndexPeriods<ITraits>               Periods;
+
+    static_assert(periods_above<ITraits>(2 * static_cast<int>(Connectivity::radius), 0, Dimension),
+                  "Periodic dimensions need a period above 2 * Radius of the Connectivity!");
+
+    static constexpr std::size_t Size     = MaskFiller::rows - 1;
+    static constexpr std::size_t HalfSize = Size / 2;
+    typedef std::array<Type, Size>              OffsetsType;
 
 public:
     KDTreeIndexNeigbourhood(Tree& tree):
         _tree(tree),
-        offsets()
+        _offsets()
     {
-        MaskFiller::assign(offsets);
+        /// the mask mirrors around its zero center, the rows behind it are
+        /// placed first so that they form the half neighbourhood
+        MaskType mask;
+        MaskFiller::assign(mask);
+        for (std::size_t i = 0; i < HalfSize; ++i)
+        {
+            _offsets[i] = mask[HalfSize + 1 + i];
+            _offsets[HalfSize + i] = mask[i];
+        }
     }
 
+    /// all neighbours in unspecified order
     template<typename F>
     void visit(const Type& reference, F&& fun)
     {
-        for (const Type& offset : offsets)
-        {
-            Type index = apply(reference, offset);
-            auto node = _tree.find(index);
-            if (node)
-                fun(*node);
-        }
+        visit(reference, Size, fun);
+    }
+
+    /// one neighbour out of every pair of opposite offsets, for symmetric
+    /// relations every pair of neighbouring cells is seen exactly once
+    template<typename F>
+    void visit_half(const Type& reference, F&& fun)
+    {
+        visit(reference, HalfSize, fun);
     }
 
 private:
-    inline constexpr Type apply(const Type& base, const Type& offset)
+    template<typename F>
+    inline void visit(const Type& reference, std::size_t count, F& fun)
     {
-        Type result;
-        for (std::size_t i = 0; i < Dimension; ++i)
-            result[i] = base[i] + offset[i];
-        return result;
+        OffsetsType queries;
+        AO::add_each(reference, _offsets.data(), queries.data(), count);
+        Periods::wrap(queries.data(), queries.data() + count);
+        _tree.find_each(queries.data(), queries.data() + count, _stack, fun);
     }
 
 private:
     Tree& _tree;
-    MaskType offsets;
+    OffsetsType _offsets;
+    FindStackType _stack;
 };
 
 }
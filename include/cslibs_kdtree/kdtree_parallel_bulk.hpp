@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <memory>
+#include <exception>
+#include <iterator>
+#include <algorithm>
+#include "flat_hash_map.hpp"
+
+namespace kdtree
+{
+
+/// Parallel front end for insert_bulk / load_bulk. The input range is cut
+/// into one contiguous block per thread, every thread merges its block into
+/// a local cell buffer. The local buffers are handed to the tree in block
+/// order, so cells and merge order match a sequential insert_bulk loop.
+/// Thread buffers are kept between calls.
+template<typename TreeType>
+class KDTreeParallelBulkLoad
+{
+public:
+    typedef TreeType                                KDTreeType;
+    typedef typename KDTreeType::IndexType          IndexType;
+    typedef typename KDTreeType::DataType           DataType;
+    typedef FlatHashMap<IndexType, DataType>        BufferType;
+
+    static constexpr std::size_t DEFAULT_BUFFER_CAPACITY = 1024;
+
+public:
+    /// threads == 0 uses the hardware concurrency
+    KDTreeParallelBulkLoad(KDTreeType& tree, std::size_t threads = 0) :
+        _tree(tree)
+    {
+        if (threads == 0)
+            threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+        for (std::size_t i = 0; i < threads; ++i)
+            _buffers.emplace_back(new BufferType(DEFAULT_BUFFER_CAPACITY));
+    }
+
+    /// create(sample) has to return a std::pair<IndexType, DataType>
+    template<typename Iterator, typename F>
+    inline void insert_bulk(Iterator begin, Iterator end, const F& create)
+    {
+        const std::size_t size = std::distance(begin, end);
+        const std::size_t threads = std::max<std::size_t>(1, std::min(_buffers.size(), size));
+        const std::size_t block = (size + threads - 1) / std::max<std::size_t>(1, threads);
+
+        std::vector<std::exception_ptr> errors(threads);
+        auto fill = [&](std::size_t t)
+        {
+            try
+            {
+                BufferType& buffer = *_buffers[t];
+                buffer.clear();
+
+                Iterator it = begin;
+                std::advance(it, std::min(size, t * block));
+                Iterator last = begin;
+                std::advance(last, std::min(size, (t + 1) * block));
+                for (; it != last; ++it)
+                {
+                    auto entry = create(*it);
+                    auto inserted = buffer.emplace(std::move(entry.first), std::move(entry.second));
+                    if (!inserted.second)
+                        inserted.first->merge(std::move(entry.second));
+                }
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (std::size_t t = 1; t < threads; ++t)
+            workers.emplace_back(fill, t);
+        fill(0);
+        for (std::thread& worker : workers)
+            worker.join();
+
+        for (std::exception_ptr& error : errors)
+            if (error)
+                std::rethrow_exception(error);
+
+        for (std::size_t t = 0; t < threads; ++t)
+        {
+            BufferType& buffer = *_buffers[t];
+            for (auto& entry : buffer)
+                _tree.insert_bulk(std::move(entry.first), std::move(entry.second));
+            buffer.clear();
+        }
+    }
+
+    template<typename Iterator, typename F>
+    inline void load_bulk(Iterator begin, Iterator end, const F& create)
+    {
+        insert_bulk(begin, end, create);
+        _tree.load_bulk();
+    }
+
+    inline std::size_t thread_count() const
+    {
+        return _buffers.size();
+    }
+
+private:
+    KDTreeType& _tree;
+    std::vector<std::unique_ptr<BufferType>> _buffers;
+};
+
+}
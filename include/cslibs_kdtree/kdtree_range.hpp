@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace kdtree
+{
+
+/// Range queries on a KDTreeNode tree. A subtree is only entered if the side
+/// of its parent's pivot overlaps the query, so the cost follows the number
+/// of cells near the range instead of its volume.
+/// Pending subtrees are kept on stack above its entry size, a visitor may
+/// start another query with the same stack.
+template<typename NodeT>
+class KDTreeRange
+{
+public:
+    typedef NodeT                                   NodeType;
+    typedef typename NodeType::IndexType            IndexType;
+    typedef std::vector<std::pair<NodeType*, double>> StackType;    /// subtree and its distance bound
+
+    static constexpr std::size_t IndexDimension = NodeType::IndexDimension;
+
+    /// calls fun(NodeType&) for every leaf with min <= index <= max componentwise
+    template<typename F>
+    static inline void box(NodeType* root, const IndexType& min, const IndexType& max,
+                           StackType& stack, F&& fun)
+    {
+        if (root == nullptr)
+            return;
+
+        const std::size_t base = stack.size();
+        stack.emplace_back(root, 0.0);
+        while (stack.size() > base)
+        {
+            NodeType* node = stack.back().first;
+            stack.pop_back();
+            while (!node->is_leaf())
+            {
+                const bool left  = min[node->pivot_index] < node->pivot_value;
+                const bool right = !(max[node->pivot_index] < node->pivot_value);
+                if (left && right)
+                    stack.emplace_back(node->right, 0.0);
+                node = left ? node->left : node->right;
+            }
+
+            bool inside = true;
+            for (std::size_t i = 0; i < IndexDimension; ++i)
+                inside &= min[i] <= node->index[i] && node->index[i] <= max[i];
+            if (inside)
+                fun(*node);
+        }
+    }
+
+    /// calls fun(NodeType&) for every leaf with an index within euclidean distance radius of center
+    template<typename F>
+    static inline void radius(NodeType* root, const IndexType& center, double radius,
+                              StackType& stack, F&& fun)
+    {
+        if (root == nullptr || radius < 0.0)
+            return;
+
+        const double squared_radius = radius * radius;
+        const std::size_t base = stack.size();
+        stack.emplace_back(root, 0.0);
+        while (stack.size() > base)
+        {
+            NodeType* node = stack.back().first;
+            const double bound = stack.back().second;
+            stack.pop_back();
+            while (!node->is_leaf())
+            {
+                const double delta = center[node->pivot_index] - node->pivot_value;
+                const double far_bound = std::max(bound, delta * delta);
+                if (far_bound <= squared_radius)
+                    stack.emplace_back(delta < 0.0 ? node->right : node->left, far_bound);
+                node = delta < 0.0 ? node->left : node->right;
+            }
+
+            double distance = 0.0;
+            for (std::size_t i = 0; i < IndexDimension; ++i)
+            {
+                const double delta = static_cast<double>(node->index[i]) - static_cast<double>(center[i]);
+                distance += delta * delta;
+            }
+            if (distance <= squared_radius)
+                fun(*node);
+        }
+    }
+};
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace kdtree
+{
+
+/// pending subtree of a shared descent, the queries routed into it and their bounds
+template<typename Reference, typename IndexType>
+struct KDTreeQueryRange
+{
+    Reference  node;
+    IndexType* begin;
+    IndexType* end;
+    IndexType  lower;
+    IndexType  upper;
+};
+
+/// Answers a batch of queries in one descent. A subtree is entered once for
+/// all queries routed into it, queries are only partitioned where a pivot
+/// falls inside their bounds, which for a neighbourhood happens close to the
+/// leafs only. Partitioning costs more than the few levels left below small
+/// ranges, those follow each query on its own.
+template<typename Reference, typename IndexType>
+class KDTreeSharedDescent
+{
+public:
+    typedef KDTreeQueryRange<Reference, IndexType>  RangeType;
+    typedef std::vector<RangeType>                  StackType;
+    typedef typename IndexType::value_type          IndexValueType;
+
+    /// ranges up to this size descend query by query instead of being partitioned
+    static constexpr std::size_t SPLIT_MIN_QUERIES = 8;
+
+    /// leaf(reference) returns the leaf or nullptr for inner nodes, inner(reference)
+    /// the inner node with pivot_index, pivot_value, left and right. fun is called
+    /// for every leaf equal to a query, the queries get reordered.
+    template<typename Leaf, typename Inner, typename F>
+    static inline void find_each(Reference root, IndexType* begin, IndexType* end, StackType& stack,
+                                 Leaf&& leaf, Inner&& inner, F&& fun)
+    {
+        if (begin == end)
+            return;
+
+        RangeType range{root, begin, end, *begin, *begin};
+        for (IndexType* query = begin + 1; query != end; ++query)
+        {
+            for (std::size_t i = 0; i < range.lower.size(); ++i)
+            {
+                range.lower[i] = std::min(range.lower[i], (*query)[i]);
+                range.upper[i] = std::max(range.upper[i], (*query)[i]);
+            }
+        }
+
+        stack.clear();
+        stack.push_back(range);
+        while (!stack.empty())
+        {
+            range = stack.back();
+            stack.pop_back();
+
+            /// inner nodes the whole range passes on one side are skipped without partitioning
+            while (true)
+            {
+                if (auto* node = leaf(range.node))
+                {
+                    for (IndexType* query = range.begin; query != range.end; ++query)
+                    {
+                        if (node->equals(*query))
+                        {
+                            fun(*node);
+                            break;
+                        }
+                    }
+                    break;
+                }
+
+                const auto& node = inner(range.node);
+                const std::size_t d = node.pivot_index;
+                if (range.upper[d] < node.pivot_value)
+                    range.node = node.left;
+                else if (!(range.lower[d] < node.pivot_value))
+                    range.node = node.right;
+                else if (static_cast<std::size_t>(range.end - range.begin) <= SPLIT_MIN_QUERIES)
+                {
+                    descend_each(range, leaf, inner, fun);
+                    break;
+                }
+                else
+                {
+                    split(node, range, stack);
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    /// follows every query of the range on its own from the range's node
+    template<typename Leaf, typename Inner, typename F>
+    static inline void descend_each(const RangeType& range, Leaf& leaf, Inner& inner, F& fun)
+    {
+        for (const IndexType* query = range.begin; query != range.end; ++query)
+        {
+            Reference reference = range.node;
+            while (true)
+            {
+                if (auto* node = leaf(reference))
+                {
+                    if (node->equals(*query))
+                        fun(*node);
+                    break;
+                }
+
+                const auto& node = inner(reference);
+                reference = (*query)[node.pivot_index] < node.pivot_value ? node.left : node.right;
+            }
+        }
+    }
+
+    /// partitions the range at the pivot, both halves get tight bounds in the pivot dimension
+    template<typename Node>
+    static inline void split(const Node& node, const RangeType& range, StackType& stack)
+    {
+        const std::size_t d = node.pivot_index;
+        IndexValueType left_max = range.lower[d];
+        IndexValueType right_min = range.upper[d];
+
+        IndexType* split = range.begin;
+        for (IndexType* query = range.begin; query != range.end; ++query)
+        {
+            const IndexValueType value = (*query)[d];
+            if (value < node.pivot_value)
+            {
+                left_max = std::max(left_max, value);
+                std::swap(*query, *split);
+                ++split;
+            }
+            else
+                right_min = std::min(right_min, value);
+        }
+
+        if (split != range.end)
+        {
+            RangeType right = range;
+            right.node = node.right;
+            right.begin = split;
+            right.lower[d] = right_min;
+            stack.push_back(right);
+        }
+        if (split != range.begin)
+        {
+            RangeType left = range;
+            left.node = node.left;
+            left.end = split;
+            left.upper[d] = left_max;
+            stack.push_back(left);
+        }
+    }
+};
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+namespace kdtree
+{
+
+struct KDTreeDepthStatistics
+{
+    std::size_t nodes       = 0;
+    std::size_t leafs       = 0;
+    std::size_t min_depth   = 0;
+    std::size_t max_depth   = 0;
+    double      mean_depth  = 0.0;
+};
+
+/// leaf depth statistics of any tree exposing get_root(), the root has depth 0
+template<typename Tree>
+inline KDTreeDepthStatistics depth_statistics(const Tree& tree)
+{
+    typedef typename Tree::NodeType NodeType;
+
+    KDTreeDepthStatistics statistics;
+    const NodeType* root = tree.get_root();
+    if (root == nullptr)
+        return statistics;
+
+    statistics.min_depth = static_cast<std::size_t>(-1);
+
+    std::size_t depth_sum = 0;
+    std::vector<std::pair<const NodeType*, std::size_t>> stack{{root, 0}};
+    while (!stack.empty())
+    {
+        const NodeType* node = stack.back().first;
+        const std::size_t depth = stack.back().second;
+        stack.pop_back();
+        ++statistics.nodes;
+
+        if (node->is_leaf())
+        {
+            ++statistics.leafs;
+            depth_sum += depth;
+            statistics.min_depth = std::min(statistics.min_depth, depth);
+            statistics.max_depth = std::max(statistics.max_depth, depth);
+        }
+        else
+        {
+            stack.emplace_back(node->left, depth + 1);
+            stack.emplace_back(node->right, depth + 1);
+        }
+    }
+
+    statistics.mean_depth = static_cast<double>(depth_sum) / statistics.leafs;
+    return statistics;
+}
+
+}
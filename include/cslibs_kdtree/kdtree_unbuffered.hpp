@@ -1,12 +1,17 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 #include <stdexcept>
 #include <memory>
 #include <limits>
 #include "index.hpp"
 #include "kdtree_node.hpp"
+#include "flat_hash_map.hpp"
+#include "node_pool.hpp"
+#include "kdtree_balanced_build.hpp"
+#include "kdtree_shared_descent.hpp"
+#include "kdtree_nearest.hpp"
+#include "kdtree_range.hpp"
 
 namespace kdtree
 {
@@ -22,6 +27,13 @@ public:
     typedef DType                             DataType;
     typedef KDTree<IndexTraits, DataType>     TreeType;
     typedef KDTreeNode<IndexTraits, DataType> NodeType;
+    typedef KDTreeBalancedBuild<NodeType>     NodeBuild;
+    typedef typename NodeBuild::EntryType     EntryType;
+    typedef KDTreeSharedDescent<NodeType*, IndexType> SharedDescent;
+    typedef typename SharedDescent::StackType FindStackType;
+    typedef KDTreeNearest<NodeType>           Nearest;
+    typedef typename Nearest::ResultType      KnnResultType;
+    typedef KDTreeRange<NodeType>             Range;
     typedef std::shared_ptr<TreeType>         Ptr;
     typedef ArrayOperations<ITraits::Dimension,
                             typename IndexType::value_type,
@@ -29,6 +41,7 @@ public:
 
 
     static constexpr std::size_t DEFAULT_BULK_BUCKETS   = 1024;
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE     = 4096;
 
     static_assert(std::is_default_constructible<DataType>::value,   "DataType not default constructible");
     static_assert(std::is_move_assignable<DataType>::value,         "DataType not move assignable");
@@ -36,61 +49,83 @@ public:
     static_assert(std::is_move_assignable<IndexType>::value,        "IndexType not move assignable");
 
 public:
-    KDTree() :
+    /// nodes are taken from a pool growing in chunks of chunk_size
+    KDTree(std::size_t chunk_size = DEFAULT_CHUNK_SIZE) :
         _size(0),
         _root(nullptr),
+        _pool(chunk_size),
         _bulkload_buffer(DEFAULT_BULK_BUCKETS)
     {
-        _max_index.fill(std::numeric_limits<typename IndexType::value_type>::min());
-        _min_index.fill(std::numeric_limits<typename IndexType::value_type>::max());
+        reset_bounds();
     }
 
     virtual ~KDTree()
     {
-        clear();
     }
 
     /// disallow copy
     KDTree(const KDTree&) = delete;
     KDTree& operator=(const KDTree&) = delete;
 
+    /// hands all nodes back to the pool, memory is kept for reuse
     inline void clear()
     {
-        if (_root)
-            clear_recursive(_root);
+        _pool.reset();
+        _root = nullptr;
         _size = 0;
+        reset_bounds();
     }
 
     inline void insert(IndexType index, DataType data)
     {
+        AO::cwise_max(index, _max_index);
+        AO::cwise_min(index, _min_index);
         if (_size == 0)
         {
-            _root = new NodeType(std::move(index), std::move(data));
+            _root = allocate();
+            _root->index = std::move(index);
+            _root->data = std::move(data);
             _size += 1;
         }
         else
         {
-            AO::cwise_max(index, _max_index);
-            AO::cwise_min(index, _min_index);
             sicker_insert(_root, std::move(index), std::move(data));
         }
     }
 
     inline void insert_bulk(IndexType index, DataType data)
     {
-        auto find = _bulkload_buffer.find(index);
-        if (find != _bulkload_buffer.end())
-            find->second.merge(std::move(data));
-        else
-            _bulkload_buffer.emplace(std::move(index), std::move(data));
+        auto entry = _bulkload_buffer.emplace(std::move(index), std::move(data));
+        if (!entry.second)
+            entry.first->merge(std::move(data));
     }
 
+    /// an empty tree is built balanced from the buffer, otherwise the cells are inserted
     inline void load_bulk()
     {
-        /// may be get that indirection lost // directly use sicker_insert
-        for (std::pair<IndexType, DataType>&& pair : _bulkload_buffer)
-            insert(std::move(pair.first), std::move(pair.second));
+        if (_size > 0)
+        {
+            for (auto& pair : _bulkload_buffer)
+                insert(std::move(pair.first), std::move(pair.second));
 
+            _bulkload_buffer.clear();
+            return;
+        }
+
+        if (_bulkload_buffer.empty())
+            return;
+
+        typename NodeBuild::EntriesType& entries = _bulkload_buffer.entries();
+        for (const EntryType& entry : entries)
+        {
+            AO::cwise_max(entry.first, _max_index);
+            AO::cwise_min(entry.first, _min_index);
+        }
+        _root = NodeBuild::build(entries, [this]()
+        {
+            ++_size;
+            return allocate();
+        });
         _bulkload_buffer.clear();
     }
 
@@ -107,6 +142,99 @@ public:
         return sicker_find(_root, index);
     }
 
+    /// removes the cell at index, its parent is replaced by the sibling.
+    /// The tracked bounds are not shrunk.
+    inline bool erase(const IndexType& index)
+    {
+        if (_size == 0)
+            return false;
+
+        NodeType* parent = nullptr;
+        NodeType* node = _root;
+        while (!node->is_leaf())
+        {
+            parent = node;
+            node = node->child(index);
+        }
+
+        if (!node->equals(index))
+            return false;
+
+        if (parent == nullptr)
+        {
+            clear();
+            return true;
+        }
+
+        NodeType* sibling = parent->left == node ? parent->right : parent->left;
+        parent->collapse(*sibling);
+        _pool.release(node);
+        _pool.release(sibling);
+        _size -= 2;
+        return true;
+    }
+
+    /// erases every leaf for which pred(NodeType&) holds, returns the number erased
+    template<typename Pred>
+    inline std::size_t erase_if(Pred&& pred)
+    {
+        _erase.clear();
+        traverse_leafs([this, &pred](NodeType& node)
+        {
+            if (pred(node))
+                _erase.push_back(node.index);
+        });
+
+        for (const IndexType& index : _erase)
+            erase(index);
+        return _erase.size();
+    }
+
+    /// the k cells closest to query, nearest first as pairs of squared distance
+    /// and leaf, result is reused between calls
+    inline void knn(const IndexType& query, std::size_t k, KnnResultType& result)
+    {
+        if (_size == 0)
+        {
+            result.clear();
+            return;
+        }
+
+        Nearest::knn(_root, query, k, _knn_stack, result);
+    }
+
+    /// calls fun(NodeType&) for every cell with min <= index <= max, only
+    /// subtrees overlapping the box are entered
+    template<typename F>
+    inline void query_box(const IndexType& min, const IndexType& max, F&& fun)
+    {
+        if (_size > 0)
+            Range::box(_root, min, max, _range_stack, fun);
+    }
+
+    /// calls fun(NodeType&) for every cell within index distance radius of center
+    template<typename F>
+    inline void query_radius(const IndexType& center, double radius, F&& fun)
+    {
+        if (_size > 0)
+            Range::radius(_root, center, radius, _range_stack, fun);
+    }
+
+    /// answers the queries in [begin, end) in one descent that only branches
+    /// where a pivot separates them, fun is called for every leaf found.
+    /// The queries get reordered, stack is scratch space of the caller.
+    template<typename F>
+    inline void find_each(IndexType* begin, IndexType* end, FindStackType& stack, F&& fun)
+    {
+        if (_size == 0)
+            return;
+
+        SharedDescent::find_each(_root, begin, end, stack,
+                                 [](NodeType* node) { return node->is_leaf() ? node : nullptr; },
+                                 [](NodeType* node) -> const NodeType& { return *node; },
+                                 fun);
+    }
+
     template<typename F>
     inline void traverse_leafs(const F& fun)
     {
@@ -129,90 +257,106 @@ public:
         return _root;
     }
 
+    /// componentwise bounds of all cells inserted since the last clear(), inverted for an empty tree
+    inline const IndexType& get_min_index() const
+    {
+        return _min_index;
+    }
+
+    inline const IndexType& get_max_index() const
+    {
+        return _max_index;
+    }
+
 private:
     inline void sicker_insert(NodeType* node, IndexType&& index, DataType&& data)
     {
-        if (node->is_leaf())
-        {
-            if (node->equals(index))
-                node->merge(std::move(data));
-            else
-            {
-                node->split(new NodeType(), new NodeType(), std::move(index), std::move(data));
-                _size += 2;
-            }
-        }
+        while (!node->is_leaf())
+            node = node->child(index);
+
+        if (node->equals(index))
+            node->merge(std::move(data));
         else
         {
-            if (node->check_split(index))
-                sicker_insert(node->left, std::move(index), std::move(data));
-            else
-                sicker_insert(node->right, std::move(index), std::move(data));
+            node->split(allocate(), allocate(), std::move(index), std::move(data));
+            _size += 2;
         }
     }
 
     inline NodeType* sicker_find(NodeType* node, const IndexType& index)
     {
-        if (node == nullptr)
-            return nullptr;
+        while (!node->is_leaf())
+            node = node->child(index);
 
-        if (node->is_leaf())
-        {
-            if (node->equals(index))
-                return node;
-            else
-                return nullptr;
-        }
-        else
-        {
-            if (node->check_split(index))
-                return sicker_find(node->left, index);
-            else
-                return sicker_find(node->right, index);
-        }
+        return node->equals(index) ? node : nullptr;
     }
 
-    inline void clear_recursive(NodeType* root)
+    inline void reset_bounds()
     {
-        if (root->left)
-            clear_recursive(root->left);
-        if (root->right)
-            clear_recursive(root->right);
+        _max_index.fill(std::numeric_limits<typename IndexType::value_type>::min());
+        _min_index.fill(std::numeric_limits<typename IndexType::value_type>::max());
+    }
 
-        delete root;
+    inline NodeType* allocate()
+    {
+        NodeType* node = _pool.allocate();
+        node->clear();
+        return node;
     }
 
+    /// traversals keep their pending nodes on _stack above the entry size,
+    /// so a visitor may start another traversal of the same tree
+
     template<typename F>
-    inline void traverse_leafs_recursive(const F& fun, NodeType* node)
+    inline void traverse_leafs_recursive(const F& fun, NodeType* root)
     {
-        if (node->is_leaf())
-            fun(*node);
-        else
+        const std::size_t base = _stack.size();
+        _stack.push_back(root);
+        while (_stack.size() > base)
         {
-            traverse_leafs_recursive(fun, node->left);
-            traverse_leafs_recursive(fun, node->right);
+            NodeType* node = _stack.back();
+            _stack.pop_back();
+            if (node->is_leaf())
+                fun(*node);
+            else
+            {
+                _stack.push_back(node->right);
+                _stack.push_back(node->left);
+            }
         }
     }
 
     template<typename F>
-    inline void traverse_nodes_recursive(const F& fun, NodeType* node)
+    inline void traverse_nodes_recursive(const F& fun, NodeType* root)
     {
-        fun(*node);
-        if (!node->is_leaf())
+        const std::size_t base = _stack.size();
+        _stack.push_back(root);
+        while (_stack.size() > base)
         {
-            traverse_nodes_recursive(fun, node->left);
-            traverse_nodes_recursive(fun, node->right);
+            NodeType* node = _stack.back();
+            _stack.pop_back();
+            fun(*node);
+            if (!node->is_leaf())
+            {
+                _stack.push_back(node->right);
+                _stack.push_back(node->left);
+            }
         }
     }
 
 private:
     std::size_t _size;
     NodeType*   _root;
+    NodePool<NodeType>     _pool;
+    std::vector<NodeType*> _stack;
+    std::vector<IndexType> _erase;
+    typename Nearest::StackType _knn_stack;
+    typename Range::StackType   _range_stack;
 
     IndexType   _min_index;
     IndexType   _max_index;
 
-    std::unordered_map<IndexType, DataType> _bulkload_buffer;
+    FlatHashMap<IndexType, DataType>        _bulkload_buffer;
 };
 
 }
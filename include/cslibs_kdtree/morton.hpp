@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+namespace kdtree
+{
+namespace detail
+{
+    /// spreads the lowest bits of value so that Dim - 1 zero bits follow each of them
+    template<std::size_t Dim>
+    struct morton_spread
+    {
+        static constexpr std::size_t Bits = 64 / Dim;
+
+        static inline std::uint64_t apply(std::uint64_t value)
+        {
+            std::uint64_t result = 0;
+            for (std::size_t b = 0; b < Bits; ++b)
+                result |= ((value >> b) & 1ull) << (b * Dim);
+            return result;
+        }
+    };
+
+    template<>
+    struct morton_spread<1>
+    {
+        static constexpr std::size_t Bits = 64;
+
+        static inline std::uint64_t apply(std::uint64_t value)
+        {
+            return value;
+        }
+    };
+
+    template<>
+    struct morton_spread<2>
+    {
+        static constexpr std::size_t Bits = 32;
+
+        static inline std::uint64_t apply(std::uint64_t value)
+        {
+            value &= 0x00000000ffffffffull;
+            value = (value | (value << 16)) & 0x0000ffff0000ffffull;
+            value = (value | (value << 8))  & 0x00ff00ff00ff00ffull;
+            value = (value | (value << 4))  & 0x0f0f0f0f0f0f0f0full;
+            value = (value | (value << 2))  & 0x3333333333333333ull;
+            value = (value | (value << 1))  & 0x5555555555555555ull;
+            return value;
+        }
+    };
+
+    template<>
+    struct morton_spread<3>
+    {
+        static constexpr std::size_t Bits = 21;
+
+        static inline std::uint64_t apply(std::uint64_t value)
+        {
+            value &= 0x00000000001fffffull;
+            value = (value | (value << 32)) & 0x001f00000000ffffull;
+            value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+            value = (value | (value << 8))  & 0x100f00f00f00f00full;
+            value = (value | (value << 4))  & 0x10c30c30c30c30c3ull;
+            value = (value | (value << 2))  & 0x1249249249249249ull;
+            return value;
+        }
+    };
+}
+
+/// Z-order key of integer cell indices. Every dimension keeps 64 / Dim bits
+/// around zero, indices outside that range wrap and may share keys, users
+/// have to break such ties with the index itself.
+template<std::size_t Dim, typename IndexValueType = int>
+struct MortonCode
+{
+    typedef std::uint64_t                       KeyType;
+    typedef std::array<IndexValueType, Dim>     IndexType;
+    typedef detail::morton_spread<Dim>          Spread;
+
+    static constexpr std::size_t Bits   = Spread::Bits;
+    static constexpr std::uint64_t Bias = 1ull << (Bits - 1);
+
+    static_assert(Dim > 0 && Dim <= 64, "Dimension has to fit into a 64 bit key");
+
+    static inline KeyType encode(const IndexType& index)
+    {
+        KeyType key = 0;
+        for (std::size_t i = 0; i < Dim; ++i)
+        {
+            const std::uint64_t value = static_cast<std::uint64_t>(static_cast<std::int64_t>(index[i])) + Bias;
+            key |= Spread::apply(value) << i;
+        }
+        return key;
+    }
+};
+
+}
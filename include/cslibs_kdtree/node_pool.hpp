@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include "chunk_buffer.hpp"
+
+namespace kdtree
+{
+
+/// Node allocator on top of chunked storage. Released nodes are kept on a
+/// free list, reset() hands back every node at once without freeing memory.
+/// Returned nodes keep the state of their last use.
+template<typename T>
+class NodePool
+{
+public:
+    typedef T ValueType;
+
+    static constexpr std::size_t DEFAULT_CHUNK_SIZE = ChunkBuffer<T>::DEFAULT_CHUNK_SIZE;
+
+public:
+    NodePool(std::size_t chunk_size = DEFAULT_CHUNK_SIZE) :
+        _used(0),
+        _nodes(chunk_size)
+    {
+    }
+
+    /// disallow copy
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    inline T* allocate()
+    {
+        if (!_free.empty())
+        {
+            T* node = _free.back();
+            _free.pop_back();
+            return node;
+        }
+
+        _nodes.reserve(_used + 1);
+        return &(_nodes[_used++]);
+    }
+
+    inline void release(T* node)
+    {
+        _free.push_back(node);
+    }
+
+    inline void reset()
+    {
+        _used = 0;
+        _free.clear();
+    }
+
+    /// nodes currently handed out
+    inline std::size_t size() const
+    {
+        return _used - _free.size();
+    }
+
+    inline std::size_t capacity() const
+    {
+        return _nodes.capacity();
+    }
+
+private:
+    std::size_t     _used;
+    ChunkBuffer<T>  _nodes;
+    std::vector<T*> _free;
+};
+
+}
@@ -7,6 +7,8 @@
 #include <iostream>
 #include <memory>
 #include <sstream>
+#include <algorithm>
+#include <stdexcept>
 
 namespace kdtree {
 template<typename T, std::size_t Depth>
@@ -20,127 +22,182 @@ public:
 
     /// size :  size[i] = max_index[i] - min_index[i] + 1;
 
+    /// entries per slab block, raised to the largest stage if that is bigger
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 4096;
+
     //// ------------------------- internal helper classes for allocation ------------------------------ ////
-    template<std::size_t Stage, typename V>
-    struct Table {
-        typedef std::shared_ptr<Table<Stage,V>> Ptr;
-        typedef Table<Stage+1, V>               NextStage;
-
-        Table(const Size &_size) :
-            size(_size),
-            data(size[Stage]),
-            data_ptr(data.data())
+    /// Hands out tables as consecutive runs of entries from fixed size blocks.
+    /// Blocks are never freed before destruction, rewinding makes them all
+    /// available again without touching their contents.
+    template<typename E>
+    struct Slab {
+        Slab() :
+            block_size(0),
+            block(0),
+            used(0),
+            count(0)
         {
         }
 
-        inline V & at(const Index &_index)
-        {
-            if(_index[Stage] >= size[Stage])
-                throw std::out_of_range("Index is out of range at entry '" + str(Stage) + "'");
+        Slab(const Slab &other) = delete;
+        Slab & operator = (const Slab &other) = delete;
 
-            typename Table<Stage+1,V>::Ptr &t = data_ptr[_index[Stage]];
-            if(!t) {
-                t.reset(new NextStage(size));
+        /// table of n default entries, n <= block_size
+        inline E * allocate(const std::size_t n)
+        {
+            if(block < blocks.size() && used + n > block_size) {
+                ++block;
+                used = 0;
             }
-            return t->at(_index);
+            if(block == blocks.size())
+                blocks.emplace_back(new E[block_size]);
+
+            E *table = blocks[block].get() + used;
+            std::fill(table, table + n, E());
+            used  += n;
+            count += n;
+            return table;
         }
 
-        inline void printInfo() const
+        inline void rewind()
         {
-            std::size_t s  = getSize();
-            std::size_t bs = getByteSize();
-            std::cout << "[Page :] '" << s << "' elements" << std::endl;
-            std::cout << "[Page :] '" << bs / (1024.0 * 1024.0) << "' MB" << std::endl;
+            block = 0;
+            used  = 0;
+            count = 0;
+        }
 
+        /// new block size, drops the blocks if they are too small
+        inline void setBlockSize(const std::size_t _block_size)
+        {
+            if(_block_size > block_size) {
+                blocks.clear();
+                block_size = _block_size;
+            }
+            rewind();
         }
 
         inline std::size_t getSize() const
         {
-            std::size_t s = size[Stage];
-            for(typename NextStage::Ptr entry : data) {
-                if(entry)
-                    s += entry->getSize();
-            }
-            return s;
+            return count;
         }
 
         inline std::size_t getByteSize() const
         {
-            std::size_t s = sizeof(typename NextStage::Ptr) * size[Stage];
-            for(typename NextStage::Ptr entry : data) {
-                if(entry)
-                    s += entry->getByteSize();
-            }
-            return s;
+            return blocks.size() * block_size * sizeof(E);
         }
 
-        const Size                           size;
-        std::vector<typename NextStage::Ptr> data;
-        typename NextStage::Ptr             *data_ptr;
-
+        std::vector<std::unique_ptr<E[]>> blocks;
+        std::size_t                       block_size;
+        std::size_t                       block;
+        std::size_t                       used;
+        std::size_t                       count;
     };
 
-    template<typename V>
-    struct Table<Depth-1, V> {
-        typedef std::shared_ptr<Table<Depth-1,V>> Ptr;
-
-        Table(const Size _size) :
-            Stage(Depth-1),
-            size(_size[Stage]),
-            data(size),
-            data_ptr(data.data())
-        {
-        }
+    typedef void*     InnerEntry;   /// first entry of the next stage table, nullptr if untouched
+    typedef Slab<InnerEntry> InnerSlab;
+    typedef Slab<T>          LeafSlab;
 
-        Table(const Table &other) = delete;
-        Table & operator = (const Table &other) = delete;
+    //// ------------------------- paging ------------------------------ ////
+    Page(const Size &_size) :
+        root(nullptr)
+    {
+        reset(_size);
+    }
 
-        inline V & at(const Index &_index)
-        {
-            if(_index[Stage] >= size)
-                throw std::out_of_range("Index is out of range at entry '" + str(Stage) + "'");
+    Page(const Page &other) = delete;
+    Page & operator = (const Page &other) = delete;
 
-            return data_ptr[_index[Stage]];
+    inline T & at(const Index &_index)
+    {
+        if(!root)
+            root = inner.allocate(size[0]);
+
+        void *table = root;
+        for(std::size_t stage = 0 ; stage < Depth - 1 ; ++stage) {
+            if(_index[stage] >= size[stage])
+                throw std::out_of_range("Index is out of range at entry '" + str(stage) + "'");
+
+            InnerEntry &entry = static_cast<InnerEntry*>(table)[_index[stage]];
+            if(!entry) {
+                if(stage + 1 < Depth - 1)
+                    entry = inner.allocate(size[stage + 1]);
+                else
+                    entry = leafs.allocate(size[stage + 1]);
+            }
+            table = entry;
         }
 
-        inline std::size_t getSize() const
-        {
-            return size;
-        }
+        if(_index[Depth - 1] >= size[Depth - 1])
+            throw std::out_of_range("Index is out of range at entry '" + str(Depth - 1) + "'");
+        return static_cast<T*>(table)[_index[Depth - 1]];
+    }
 
-        inline std::size_t getByteSize() const
-        {
-            return size * sizeof(V);
+    /// entry without allocating, nullptr if it was never touched since the last reset
+    inline T * find(const Index &_index) const
+    {
+        void *table = root;
+        for(std::size_t stage = 0 ; stage < Depth - 1 ; ++stage) {
+            if(!table || _index[stage] >= size[stage])
+                return nullptr;
+            table = static_cast<InnerEntry*>(table)[_index[stage]];
         }
 
-        const std::size_t Stage;
-        const std::size_t size;
-        std::vector<V>    data;
-        V                *data_ptr;
-    };
+        if(!table || _index[Depth - 1] >= size[Depth - 1])
+            return nullptr;
+        return static_cast<T*>(table) + _index[Depth - 1];
+    }
 
+    /// drops all tables, the slab memory is kept for the next frame
+    inline void reset()
+    {
+        root = nullptr;
+        inner.rewind();
+        leafs.rewind();
+    }
 
-    //// ------------------------- paging ------------------------------ ////
-    Page(const Size &_size) :
-        table(_size)
+    /// drops all tables and changes the size
+    inline void reset(const Size &_size)
     {
+        size = _size;
+        root = nullptr;
+        std::size_t max_inner = 0;
+        for(std::size_t i = 0 ; i < Depth - 1 ; ++i) {
+            max_inner = std::max(max_inner, size[i]);
+        }
+        inner.setBlockSize(std::max(DEFAULT_BLOCK_SIZE, max_inner));
+        leafs.setBlockSize(std::max(DEFAULT_BLOCK_SIZE, size[Depth - 1]));
     }
 
-    Page(const Page &other) = delete;
-    Page & operator = (const Page &other) = delete;
+    inline const Size & getSize() const
+    {
+        return size;
+    }
 
-    inline T & at(const Index &_index)
+    /// entries handed out since the last reset
+    inline std::size_t getEntryCount() const
     {
-        return table.at(_index);
+        return inner.getSize() + leafs.getSize();
+    }
+
+    /// memory held by the slabs
+    inline std::size_t getByteSize() const
+    {
+        return inner.getByteSize() + leafs.getByteSize();
     }
 
     inline void printInfo() const
     {
-        table.printInfo();
+        std::size_t s  = getEntryCount();
+        std::size_t bs = getByteSize();
+        std::cout << "[Page :] '" << s << "' elements" << std::endl;
+        std::cout << "[Page :] '" << bs / (1024.0 * 1024.0) << "' MB" << std::endl;
     }
 
 private:
-    Table<0,T> table;
+    Size        size;
+    InnerEntry *root;
+    InnerSlab   inner;
+    LeafSlab    leafs;
 
     template<typename S>
     inline static std::string str(const S &value)
@@ -151,4 +208,7 @@ private:
     }
 
 };
+
+template<typename T, std::size_t Depth>
+constexpr std::size_t Page<T, Depth>::DEFAULT_BLOCK_SIZE;
 }
@@ -1,20 +1,25 @@
 #pragma once
 
 #include "page.hpp"
-#include "fill.hpp"
+#include "connectivity.hpp"
 #include "index.hpp"
+#include "index_periodic.hpp"
 #include <assert.h>
+#include <vector>
 
 namespace kdtree {
-template<typename Type, int Dimension>
+/// Periods declares wrapping dimensions as index traits do, see IndexPeriods,
+/// Connectivity selects the neighbourhood mask, see connectivity.hpp
+template<typename Type, int Dimension, typename Periods = IndexNotPeriodic, typename Connectivity = ConnectivityFull>
 class PageClustering {
 public:
 
-    typedef Page<Type, Dimension>                PageType;
+    typedef Page<Type*, Dimension>               PageType;
     typedef std::array<int, Dimension>           DataIndex;
     typedef typename PageType::Index             PageIndex;
-    typedef detail::fill<int, Dimension>         MaskFiller;
+    typedef typename Connectivity::template Mask<DataIndex, Dimension> MaskFiller;
     typedef typename MaskFiller::Type            MaskType;
+    typedef IndexPeriods<Periods>                Wrap;
     typedef ArrayOperations<Dimension, int, int> AO;
 
     PageClustering(std::vector<Type*>      &_entries,
@@ -44,12 +49,14 @@ public:
 
 private:
     MaskType offsets;
+    MaskType neighbours;                /// indices around the current entry
     int      cluster_count;
 
     std::vector<Type*> &entries;
     PageType           &page;
     DataIndex           min_index;
     DataIndex           max_index;
+    std::vector<Type*>  queue;          /// flood fill work list, kept between calls
 
     inline constexpr Type apply(const Type& base, const Type& offset)
     {
@@ -59,31 +66,39 @@ private:
         return result;
     }
 
-    inline void clusterEntry(Type *entry)
+    inline void clusterEntry(Type *seed)
     {
         PageIndex page_index;
-        DataIndex index;
-        for(DataIndex &offset : offsets) {
-            AO::add(entry->index, offset, index);
+        queue.clear();
+        queue.push_back(seed);
+        while(!queue.empty()) {
+            Type *entry = queue.back();
+            queue.pop_back();
+            AO::add_each(entry->index, offsets.data(), neighbours.data(), offsets.size());
+            Wrap::wrap(neighbours.data(), neighbours.data() + neighbours.size());
+            for(const DataIndex &index : neighbours) {
+                bool out_of_bounds = false;
+                for(std::size_t j = 0 ; j < Dimension ; ++j) {
+                    out_of_bounds |= index[j] < min_index[j];
+                    out_of_bounds |= index[j] > max_index[j];
+                    page_index[j]  = index[j] - min_index[j];
+                }
 
-            bool out_of_bounds = false;
-            for(std::size_t j = 0 ; j < Dimension ; ++j) {
-                out_of_bounds |= index[j] < min_index[j];
-                out_of_bounds |= index[j] > max_index[j];
-                page_index[j]  = index[j] - min_index[j];
-            }
-
-            if(out_of_bounds)
-                continue;
+                if(out_of_bounds)
+                    continue;
 
-            Type *neighbour = page.at(page_index);
-            if(!neighbour)
-                continue;
-            if(neighbour->cluster > -1)
-                continue;
-            assert(neighbour->cluster == -1);
-            neighbour->cluster = entry->cluster;
-            clusterEntry(neighbour);
+                Type **slot = page.find(page_index);
+                if(!slot)
+                    continue;
+                Type *neighbour = *slot;
+                if(!neighbour)
+                    continue;
+                if(neighbour->cluster > -1)
+                    continue;
+                assert(neighbour->cluster == -1);
+                neighbour->cluster = entry->cluster;
+                queue.push_back(neighbour);
+            }
         }
     }
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace kdtree
+{
+
+/// Growable disjoint-set for a single thread. As in ConcurrentUnionFind the
+/// root of every set is its smallest element, so the representative of a
+/// set only changes if it is united with a set of an older element.
+class UnionFind
+{
+public:
+    typedef std::uint32_t ElementType;
+
+    UnionFind() :
+        _sets(0)
+    {
+    }
+
+    /// new element in a set of its own
+    inline ElementType add()
+    {
+        const ElementType element = static_cast<ElementType>(_parents.size());
+        _parents.push_back(element);
+        ++_sets;
+        return element;
+    }
+
+    inline ElementType find(ElementType x)
+    {
+        while (_parents[x] != x)
+        {
+            /// path halving
+            _parents[x] = _parents[_parents[x]];
+            x = _parents[x];
+        }
+        return x;
+    }
+
+    /// true if a and b were in different sets
+    inline bool unite(ElementType a, ElementType b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return false;
+
+        if (a < b)
+            _parents[b] = a;
+        else
+            _parents[a] = b;
+        --_sets;
+        return true;
+    }
+
+    inline void clear()
+    {
+        _parents.clear();
+        _sets = 0;
+    }
+
+    /// number of elements
+    inline std::size_t size() const
+    {
+        return _parents.size();
+    }
+
+    /// number of disjoint sets
+    inline std::size_t sets() const
+    {
+        return _sets;
+    }
+
+private:
+    std::vector<ElementType> _parents;
+    std::size_t              _sets;
+};
+
+}
@@ -0,0 +1,1006 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <memory>
+#include <algorithm>
+#include <unordered_set>
+#include <set>
+#include <cstdio>
+#include <cstdint>
+#include <array>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+#include "../include/cslibs_kdtree/kdtree.hpp"
+#include "../include/cslibs_kdtree/page_clustering.hpp"
+#include "../include/cslibs_kdtree/array_clustering.hpp"
+
+/// Benchmark suite for regression tracking. Every case is timed with
+/// steady_clock after a number of warm-up runs, per run setup (fresh trees,
+/// cleared labels) is kept out of the measurement. Datasets are swept over
+/// dimension, occupied cell count, occupancy of the bounding grid and sample
+/// distribution, a sample file in the format of res/particles.txt adds a
+/// three dimensional dataset of recorded data.
+/// With --counters hardware events are counted around every timed run by
+/// perf_event_open on Linux, events the kernel refuses are reported empty.
+
+namespace benchmark
+{
+// ##########################
+// BEGIN Options
+// ##########################
+enum class Format
+{
+    Text,
+    CSV,
+    JSON
+};
+
+struct Options
+{
+    std::size_t              runs          = 21;
+    std::size_t              warmup        = 3;
+    std::size_t              per_cell      = 4;                             /// samples drawn per occupied cell
+    bool                     counters      = false;                         /// count hardware events per run
+    unsigned int             seed          = 42;
+    Format                   format        = Format::Text;
+    std::string              output;                                        /// file to write to, stdout if empty
+    std::string              file;                                          /// optional recorded samples
+    std::vector<std::size_t> dims          = {2, 3, 4};
+    std::vector<std::size_t> cells         = {10000, 100000};
+    std::vector<double>      occupancies   = {0.05, 0.5};
+    std::vector<std::string> distributions = {"uniform", "clustered"};
+};
+
+template<typename T>
+bool parse_list(const std::string& text, std::vector<T>& values)
+{
+    std::vector<T> result;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        std::stringstream is(item);
+        T value;
+        if (!(is >> value))
+            return false;
+        result.push_back(value);
+    }
+    if (result.empty())
+        return false;
+    values = std::move(result);
+    return true;
+}
+
+void usage(const char* name)
+{
+    std::cout << "Usage: " << name << " [options]" << std::endl
+              << "\t--runs N               timed runs per case (21)" << std::endl
+              << "\t--warmup N             untimed runs before timing (3)" << std::endl
+              << "\t--per-cell N           samples per occupied cell (4)" << std::endl
+              << "\t--seed N               random seed of the datasets (42)" << std::endl
+              << "\t--dims 2,3,4           index dimensions" << std::endl
+              << "\t--cells 10000,100000   occupied cells" << std::endl
+              << "\t--occupancy 0.05,0.5   occupied share of the bounding grid" << std::endl
+              << "\t--distribution uniform,clustered" << std::endl
+              << "\t--file <sample_data>   adds a dataset of recorded samples" << std::endl
+              << "\t--quick                small sweep for a smoke test" << std::endl
+              << "\t--counters             count cycles, instructions, cache and branch misses" << std::endl
+              << "\t--format text|csv|json output format (text)" << std::endl
+              << "\t--output <file>        write results to file instead of stdout" << std::endl;
+}
+
+bool parse(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+        {
+            options.runs   = 5;
+            options.warmup = 1;
+            options.cells  = {1000, 10000};
+            continue;
+        }
+        if (arg == "--counters")
+        {
+            options.counters = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+        const std::string value = argv[++i];
+
+        bool ok = true;
+        if (arg == "--runs")
+            ok = std::stringstream(value) >> options.runs && options.runs > 0;
+        else if (arg == "--warmup")
+            ok = static_cast<bool>(std::stringstream(value) >> options.warmup);
+        else if (arg == "--per-cell")
+            ok = std::stringstream(value) >> options.per_cell && options.per_cell > 0;
+        else if (arg == "--seed")
+            ok = static_cast<bool>(std::stringstream(value) >> options.seed);
+        else if (arg == "--dims")
+            ok = parse_list(value, options.dims);
+        else if (arg == "--cells")
+            ok = parse_list(value, options.cells);
+        else if (arg == "--occupancy")
+            ok = parse_list(value, options.occupancies);
+        else if (arg == "--distribution")
+            ok = parse_list(value, options.distributions);
+        else if (arg == "--file")
+            options.file = value;
+        else if (arg == "--output")
+            options.output = value;
+        else if (arg == "--format" && value == "text")
+            options.format = Format::Text;
+        else if (arg == "--format" && value == "csv")
+            options.format = Format::CSV;
+        else if (arg == "--format" && value == "json")
+            options.format = Format::JSON;
+        else
+            ok = false;
+
+        if (!ok)
+            return false;
+    }
+
+    for (double occupancy : options.occupancies)
+        if (!(occupancy > 0.0 && occupancy <= 1.0))
+            return false;
+    for (const std::string& distribution : options.distributions)
+        if (distribution != "uniform" && distribution != "clustered")
+            return false;
+    return true;
+}
+// ##########################
+// END Options
+// ##########################
+
+// ##########################
+// BEGIN Counters
+// ##########################
+/// Hardware event counters of the calling thread, user space only. Every
+/// event is opened on its own, so a PMU without one of them or a kernel
+/// refusing some still leaves the others. Multiplexed counts are scaled to
+/// the time the counter was enabled. Without perf_event_open support, e.g.
+/// in containers with a restrictive perf_event_paranoid or seccomp profile,
+/// no event is available and the benchmark runs on wall time alone.
+class Counters
+{
+public:
+    enum Event
+    {
+        Cycles,
+        Instructions,
+        L1DMisses,
+        LLCMisses,
+        BranchMisses,
+        EventCount
+    };
+
+    using Values = std::array<double, EventCount>;
+
+    static const char* name(std::size_t event)
+    {
+        static const char* names[EventCount] = {"cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"};
+        return names[event];
+    }
+
+    /// values of events not counted
+    static Values unavailable()
+    {
+        Values values;
+        values.fill(std::numeric_limits<double>::quiet_NaN());
+        return values;
+    }
+
+    Counters(bool enable)
+    {
+        _fds.fill(-1);
+        _errors.fill(enable ? ENOSYS : 0);
+#ifdef __linux__
+        if (!enable)
+            return;
+
+        const std::uint64_t l1d = PERF_COUNT_HW_CACHE_L1D |
+                                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        open(Cycles,       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(Instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(L1DMisses,    PERF_TYPE_HW_CACHE, l1d);
+        open(LLCMisses,    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        open(BranchMisses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+    }
+
+    ~Counters()
+    {
+#ifdef __linux__
+        for (int fd : _fds)
+            if (fd >= 0)
+                ::close(fd);
+#endif
+    }
+
+    /// disallow copy
+    Counters(const Counters&) = delete;
+    Counters& operator=(const Counters&) = delete;
+
+    inline bool available(std::size_t event) const
+    {
+        return _fds[event] >= 0;
+    }
+
+    inline bool any() const
+    {
+        for (int fd : _fds)
+            if (fd >= 0)
+                return true;
+        return false;
+    }
+
+    /// errno of the failed open, 0 if the event was not requested
+    inline int error(std::size_t event) const
+    {
+        return _errors[event];
+    }
+
+    inline void start()
+    {
+#ifdef __linux__
+        for (int fd : _fds)
+            if (fd >= 0)
+            {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+    }
+
+    /// counts since start(), NaN for events not available
+    inline Values stop()
+    {
+        Values values = unavailable();
+#ifdef __linux__
+        for (int fd : _fds)
+            if (fd >= 0)
+                ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+
+        for (std::size_t i = 0; i < EventCount; ++i)
+        {
+            std::uint64_t buffer[3];      /// value, time enabled, time running
+            if (_fds[i] < 0 || ::read(_fds[i], buffer, sizeof(buffer)) != sizeof(buffer))
+                continue;
+            values[i] = buffer[2] == 0 ? 0.0 :
+                        static_cast<double>(buffer[0]) * buffer[1] / buffer[2];
+        }
+#endif
+        return values;
+    }
+
+private:
+    std::array<int, EventCount> _fds;
+    std::array<int, EventCount> _errors;
+
+#ifdef __linux__
+    inline void open(std::size_t event, std::uint32_t type, std::uint64_t config)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size           = sizeof(attr);
+        attr.type           = type;
+        attr.config         = config;
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const long fd = ::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        _fds[event]    = fd < 0 ? -1 : static_cast<int>(fd);
+        _errors[event] = fd < 0 ? errno : 0;
+    }
+#endif
+};
+// ##########################
+// END Counters
+// ##########################
+
+// ##########################
+// BEGIN Statistics
+// ##########################
+struct Clock
+{
+    using clock         = std::chrono::steady_clock;
+    using time_point    = clock::time_point;
+    using ms            = std::chrono::duration<double, std::milli>;
+};
+
+/// run time distribution of one case in milliseconds
+struct Statistics
+{
+    std::size_t runs   = 0;
+    double      min    = 0.0;
+    double      mean   = 0.0;
+    double      median = 0.0;
+    double      p90    = 0.0;
+    double      p99    = 0.0;
+    double      max    = 0.0;
+    Counters::Values events = Counters::unavailable();     /// mean counts per run
+
+    /// nearest rank percentiles, times is sorted
+    static Statistics from(std::vector<double>& times)
+    {
+        Statistics s;
+        if (times.empty())
+            return s;
+
+        std::sort(times.begin(), times.end());
+        const auto rank = [&times](double p)
+        {
+            const std::size_t r = static_cast<std::size_t>(std::ceil(p * times.size()));
+            return times[std::max<std::size_t>(r, 1) - 1];
+        };
+
+        s.runs   = times.size();
+        s.min    = times.front();
+        s.max    = times.back();
+        s.median = rank(0.5);
+        s.p90    = rank(0.9);
+        s.p99    = rank(0.99);
+        for (double t : times)
+            s.mean += t;
+        s.mean /= times.size();
+        return s;
+    }
+};
+
+/// Calls setup() before every run, untimed, then times body(). Warm-up runs
+/// go through the same steps and are discarded. Counters only enclose body().
+template<typename Setup, typename Body>
+Statistics measure(const Options& options, Setup&& setup, Body&& body)
+{
+    Counters counters(options.counters);
+    Counters::Values events;
+    events.fill(0.0);
+
+    std::vector<double> times;
+    times.reserve(options.runs);
+    for (std::size_t i = 0; i < options.warmup + options.runs; ++i)
+    {
+        setup();
+        counters.start();
+        const Clock::time_point start = Clock::clock::now();
+        body();
+        const Clock::time_point end = Clock::clock::now();
+        const Counters::Values counts = counters.stop();
+        if (i < options.warmup)
+            continue;
+
+        times.push_back(std::chrono::duration_cast<Clock::ms>(end - start).count());
+        for (std::size_t j = 0; j < Counters::EventCount; ++j)
+            events[j] += counts[j];
+    }
+
+    Statistics statistics = Statistics::from(times);
+    for (std::size_t j = 0; j < Counters::EventCount; ++j)
+        statistics.events[j] = events[j] / options.runs;       /// NaN stays NaN
+    return statistics;
+}
+// ##########################
+// END Statistics
+// ##########################
+
+// ##########################
+// BEGIN Datasets
+// ##########################
+/// Samples are points in cell units, the index of a sample is its floor.
+template<std::size_t Dim>
+struct Dataset
+{
+    using Point  = std::array<double, Dim>;
+
+    std::string        distribution;
+    std::size_t        cells     = 0;       /// occupied cells
+    double             occupancy = 0.0;     /// occupied cells / cells of the bounding grid
+    std::vector<Point> samples;
+};
+
+/// Cells drawn without repetition from a grid sized for the occupancy,
+/// clustered datasets draw cells around a few gaussian centers instead. Every
+/// cell gets per_cell samples, the samples are shuffled.
+template<std::size_t Dim>
+Dataset<Dim> generate(const std::string& distribution, std::size_t cells, double occupancy,
+                      std::size_t per_cell, unsigned int seed)
+{
+    using Cell = std::array<long long, Dim>;
+
+    const long long side = std::max<long long>(2, static_cast<long long>(
+                                                   std::ceil(std::pow(cells / occupancy, 1.0 / Dim))));
+    long long volume = 1;
+    for (std::size_t i = 0; i < Dim; ++i)
+        volume *= side;
+    cells = std::min<std::size_t>(cells, static_cast<std::size_t>(volume));
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<long long> coordinate(0, side - 1);
+    std::normal_distribution<double>         spread(0.0, 0.5 * std::pow(1000.0, 1.0 / Dim));
+    std::vector<Cell> centers(std::max<std::size_t>(1, cells / 1000));
+    for (Cell& center : centers)
+        for (std::size_t i = 0; i < Dim; ++i)
+            center[i] = coordinate(rng);
+    std::uniform_int_distribution<std::size_t> pick(0, centers.size() - 1);
+
+    const bool clustered = distribution == "clustered";
+    std::unordered_set<long long> taken;
+    std::vector<Cell> occupied;
+    occupied.reserve(cells);
+    while (occupied.size() < cells)
+    {
+        Cell cell;
+        const Cell& center = centers[pick(rng)];
+        for (std::size_t i = 0; i < Dim; ++i)
+        {
+            cell[i] = clustered ? center[i] + static_cast<long long>(std::floor(spread(rng))) : coordinate(rng);
+            cell[i] = std::min(std::max(cell[i], 0ll), side - 1);
+        }
+
+        long long key = 0;
+        for (std::size_t i = 0; i < Dim; ++i)
+            key = key * side + cell[i];
+        if (taken.insert(key).second)
+            occupied.push_back(cell);
+    }
+
+    Dataset<Dim> dataset;
+    dataset.distribution = distribution;
+    dataset.cells        = cells;
+    dataset.occupancy    = static_cast<double>(cells) / volume;
+
+    std::uniform_real_distribution<double> jitter(0.0, 1.0);
+    dataset.samples.reserve(cells * per_cell);
+    for (const Cell& cell : occupied)
+        for (std::size_t j = 0; j < per_cell; ++j)
+        {
+            typename Dataset<Dim>::Point point;
+            for (std::size_t i = 0; i < Dim; ++i)
+                point[i] = cell[i] + jitter(rng);
+            dataset.samples.push_back(point);
+        }
+    std::shuffle(dataset.samples.begin(), dataset.samples.end(), rng);
+    return dataset;
+}
+
+/// recorded samples binned as in kdtree-test, 0.5 m in x / y and 10 deg in yaw
+Dataset<3> load(const std::string& file)
+{
+    static const double bin_sizes[3] = {0.5, 0.5, 10 * M_PI / 180.0};
+
+    Dataset<3> dataset;
+    dataset.distribution = "file";
+
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::stringstream ss(line);
+        Dataset<3>::Point point;
+        if (!(ss >> point[0] >> point[1] >> point[2]))
+            continue;
+        for (std::size_t i = 0; i < 3; ++i)
+            point[i] /= bin_sizes[i];
+        dataset.samples.push_back(point);
+    }
+
+    std::set<std::array<long long, 3>> occupied;
+    std::array<long long, 3> min_cell, max_cell;
+    min_cell.fill(std::numeric_limits<long long>::max());
+    max_cell.fill(std::numeric_limits<long long>::min());
+    for (const Dataset<3>::Point& point : dataset.samples)
+    {
+        std::array<long long, 3> cell;
+        for (std::size_t i = 0; i < 3; ++i)
+        {
+            cell[i] = static_cast<long long>(std::floor(point[i]));
+            min_cell[i] = std::min(min_cell[i], cell[i]);
+            max_cell[i] = std::max(max_cell[i], cell[i]);
+        }
+        occupied.insert(cell);
+    }
+
+    double volume = 1.0;
+    for (std::size_t i = 0; i < 3; ++i)
+        volume *= static_cast<double>(max_cell[i] - min_cell[i] + 1);
+    dataset.cells     = occupied.size();
+    dataset.occupancy = occupied.empty() ? 0.0 : occupied.size() / volume;
+    return dataset;
+}
+// ##########################
+// END Datasets
+// ##########################
+
+// ##########################
+// BEGIN KDTree structures
+// ##########################
+template<std::size_t Dim>
+struct Index
+{
+    using                           Type        = std::array<int, Dim>;
+    using                           PivotType   = double;
+    static constexpr std::size_t    Dimension   = Dim;
+
+    static inline Type create(const typename Dataset<Dim>::Point& point)
+    {
+        Type index;
+        for (std::size_t i = 0; i < Dim; ++i)
+            index[i] = static_cast<int>(std::floor(point[i]));
+        return index;
+    }
+};
+
+struct Data : public kdtree::KDTreeNodeClusteringSupport
+{
+    std::size_t samples;
+    double      weight;
+
+    inline void merge(Data&& other)
+    {
+        samples += other.samples;
+        weight  += other.weight;
+    }
+
+    static inline Data create()
+    {
+        Data data;
+        data.samples = 1;
+        data.weight  = 1.0;
+        return data;
+    }
+};
+
+/// occupied cells for the Page / Array engines
+template<std::size_t Dim>
+struct Cell
+{
+    std::array<int, Dim> index;
+    int                  cluster;
+};
+// ##########################
+// END KDTree structures
+// ##########################
+
+// ##########################
+// BEGIN Cases
+// ##########################
+struct Result
+{
+    std::string case_name;
+    std::size_t dim;
+    std::string distribution;
+    std::size_t cells;
+    double      occupancy;
+    std::size_t samples;
+    Statistics  statistics;
+};
+
+using Results = std::vector<Result>;
+
+template<std::size_t Dim>
+struct Suite
+{
+    using DatasetType    = Dataset<Dim>;
+    using IndexType      = Index<Dim>;
+    using Unbuffered     = kdtree::unbuffered::KDTree<IndexType, Data>;
+    using Buffered       = kdtree::buffered::KDTree<IndexType, Data>;
+    using CellType       = Cell<Dim>;
+    using PageEngine     = kdtree::PageClustering<CellType, Dim>;
+    using ArrayEngine    = kdtree::ArrayClustering<CellType, Dim>;
+    using ArrayType      = kdtree::Array<CellType*, Dim>;
+
+    const Options&     options;
+    const DatasetType& dataset;
+    Results&           results;
+
+    std::vector<typename IndexType::Type> indices;      /// index of every sample
+
+    Suite(const Options& options, const DatasetType& dataset, Results& results) :
+        options(options),
+        dataset(dataset),
+        results(results)
+    {
+        indices.reserve(dataset.samples.size());
+        for (const typename DatasetType::Point& point : dataset.samples)
+            indices.push_back(IndexType::create(point));
+    }
+
+    void add(const std::string& name, const Statistics& statistics)
+    {
+        results.push_back(Result{name, Dim, dataset.distribution, dataset.cells,
+                                 dataset.occupancy, dataset.samples.size(), statistics});
+    }
+
+    template<typename Tree>
+    void insert(const std::string& name)
+    {
+        std::unique_ptr<Tree> tree;
+        add(name, measure(options,
+                          [&tree]() { tree.reset(new Tree); },
+                          [this, &tree]()
+        {
+            for (const typename IndexType::Type& index : indices)
+                tree->insert(index, Data::create());
+        }));
+    }
+
+    template<typename Tree>
+    void bulk(const std::string& name)
+    {
+        std::unique_ptr<Tree> tree;
+        add(name, measure(options,
+                          [&tree]() { tree.reset(new Tree); },
+                          [this, &tree]()
+        {
+            for (const typename IndexType::Type& index : indices)
+                tree->insert_bulk(index, Data::create());
+            tree->load_bulk();
+        }));
+    }
+
+    /// the bulk load split into its phases, filling the buffer and load_bulk()
+    template<typename Tree>
+    void bulk_phases(const std::string& name)
+    {
+        std::unique_ptr<Tree> tree;
+        add(name + "_fill", measure(options,
+                                    [&tree]() { tree.reset(new Tree); },
+                                    [this, &tree]()
+        {
+            for (const typename IndexType::Type& index : indices)
+                tree->insert_bulk(index, Data::create());
+        }));
+        add(name + "_load", measure(options,
+                                    [this, &tree]()
+        {
+            tree.reset(new Tree);
+            for (const typename IndexType::Type& index : indices)
+                tree->insert_bulk(index, Data::create());
+        },
+                                    [&tree]() { tree->load_bulk(); }));
+    }
+
+    template<typename Tree>
+    void build(Tree& tree)
+    {
+        for (const typename IndexType::Type& index : indices)
+            tree.insert_bulk(index, Data::create());
+        tree.load_bulk();
+    }
+
+    /// one lookup per sample, every lookup hits
+    template<typename Tree>
+    void find(const std::string& name)
+    {
+        Tree tree;
+        build(tree);
+        volatile std::size_t sink = 0;
+        add(name, measure(options,
+                          []() {},
+                          [this, &tree, &sink]()
+        {
+            std::size_t found = 0;
+            for (const typename IndexType::Type& index : indices)
+                found += tree.find(index) != nullptr;
+            sink = found;
+        }));
+    }
+
+    template<typename Tree>
+    void clustering(const std::string& name)
+    {
+        using NodeType = typename Tree::NodeType;
+        Tree tree;
+        build(tree);
+        kdtree::KDTreeClustering<Tree> clustering(tree);
+        add(name, measure(options,
+                          [&tree]()
+        {
+            tree.traverse_leafs([](NodeType& node) { node.data.cluster = -1; });
+        },
+                          [&clustering]() { clustering.cluster(); }));
+    }
+
+    /// cells relative to the minimum index, bounds as PageClustering expects them
+    void engine_cells(std::vector<CellType>& cells, std::vector<CellType*>& entries,
+                      std::array<int, Dim>& min_index, std::array<int, Dim>& max_index,
+                      std::array<std::size_t, Dim>& size)
+    {
+        Unbuffered tree;
+        build(tree);
+        min_index = tree.get_min_index();
+        max_index = tree.get_max_index();
+        tree.traverse_leafs([&cells](const typename Unbuffered::NodeType& node)
+        {
+            cells.push_back(CellType{node.index, -1});
+        });
+        for (CellType& cell : cells)
+            entries.push_back(&cell);
+        for (std::size_t i = 0; i < Dim; ++i)
+            size[i] = static_cast<std::size_t>(max_index[i] - min_index[i]) + 1;
+    }
+
+    /// filling the page and clustering, the page is reset between runs
+    void page(const std::string& name)
+    {
+        std::vector<CellType>        cells;
+        std::vector<CellType*>       entries;
+        std::array<int, Dim>         min_index, max_index;
+        std::array<std::size_t, Dim> size;
+        engine_cells(cells, entries, min_index, max_index, size);
+
+        typename PageEngine::PageType page(size);
+        add(name, measure(options,
+                          [&page, &entries]()
+        {
+            page.reset();
+            for (CellType* cell : entries)
+                cell->cluster = -1;
+        },
+                          [&]()
+        {
+            typename PageEngine::PageType::Index index;
+            for (CellType* cell : entries)
+            {
+                for (std::size_t i = 0; i < Dim; ++i)
+                    index[i] = static_cast<std::size_t>(cell->index[i] - min_index[i]);
+                page.at(index) = cell;
+            }
+            PageEngine clustering(entries, page, min_index, max_index);
+            clustering.cluster();
+        }));
+    }
+
+    /// filling the array and clustering, the array is reset between runs
+    void array(const std::string& name)
+    {
+        std::vector<CellType>        cells;
+        std::vector<CellType*>       entries;
+        std::array<int, Dim>         min_index, max_index;
+        std::array<std::size_t, Dim> size;
+        engine_cells(cells, entries, min_index, max_index, size);
+
+        ArrayType array(size);
+        add(name, measure(options,
+                          [&array, &entries]()
+        {
+            array.reset(nullptr);
+            for (CellType* cell : entries)
+                cell->cluster = -1;
+        },
+                          [&]()
+        {
+            typename ArrayType::Index index;
+            for (CellType* cell : entries)
+            {
+                for (std::size_t i = 0; i < Dim; ++i)
+                    index[i] = static_cast<std::size_t>(cell->index[i] - min_index[i]);
+                array.at(index) = cell;
+            }
+            ArrayEngine clustering(entries, array, min_index, max_index);
+            clustering.cluster();
+        }));
+    }
+
+    void run()
+    {
+        insert<Unbuffered>("insert_unbuffered");
+        insert<Buffered>("insert_buffered");
+        bulk<Unbuffered>("bulk_unbuffered");
+        bulk<Buffered>("bulk_buffered");
+        bulk_phases<Unbuffered>("bulk_unbuffered");
+        bulk_phases<Buffered>("bulk_buffered");
+        find<Unbuffered>("find_unbuffered");
+        find<Buffered>("find_buffered");
+        clustering<Unbuffered>("clustering_unbuffered");
+        clustering<Buffered>("clustering_buffered");
+        page("page_clustering");
+        array("array_clustering");
+    }
+};
+
+template<std::size_t Dim>
+void sweep(const Options& options, Results& results)
+{
+    for (const std::string& distribution : options.distributions)
+        for (std::size_t cells : options.cells)
+            for (double occupancy : options.occupancies)
+            {
+                const Dataset<Dim> dataset = generate<Dim>(distribution, cells, occupancy,
+                                                           options.per_cell, options.seed);
+                std::cerr << "dim " << Dim << ", " << distribution << ", " << dataset.cells
+                          << " cells, occupancy " << dataset.occupancy << std::endl;
+                Suite<Dim>(options, dataset, results).run();
+            }
+}
+// ##########################
+// END Cases
+// ##########################
+
+// ##########################
+// BEGIN Output
+// ##########################
+/// event columns are only written with --counters, missing counts stay empty
+void write_text(std::ostream& out, const Options& options, const Results& results)
+{
+    out << "case                        dim distribution  cells      occupancy samples    "
+           "  median ms     p90 ms     p99 ms    mean ms";
+    if (options.counters)
+        for (std::size_t j = 0; j < Counters::EventCount; ++j)
+        {
+            char column[32];
+            std::snprintf(column, sizeof(column), " %14s", Counters::name(j));
+            out << column;
+        }
+    out << std::endl;
+
+    for (const Result& r : results)
+    {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-27s %3zu %-13s %-10zu %-9.4f %-10zu %10.4f %10.4f %10.4f %10.4f",
+                      r.case_name.c_str(), r.dim, r.distribution.c_str(), r.cells, r.occupancy, r.samples,
+                      r.statistics.median, r.statistics.p90, r.statistics.p99, r.statistics.mean);
+        out << line;
+        if (options.counters)
+            for (double value : r.statistics.events)
+            {
+                char column[32];
+                if (std::isnan(value))
+                    std::snprintf(column, sizeof(column), " %14s", "-");
+                else
+                    std::snprintf(column, sizeof(column), " %14.0f", value);
+                out << column;
+            }
+        out << std::endl;
+    }
+}
+
+void write_csv(std::ostream& out, const Options& options, const Results& results)
+{
+    out << "case,dim,distribution,cells,occupancy,samples,runs,min_ms,mean_ms,median_ms,p90_ms,p99_ms,max_ms";
+    if (options.counters)
+        for (std::size_t j = 0; j < Counters::EventCount; ++j)
+            out << "," << Counters::name(j);
+    out << std::endl;
+
+    for (const Result& r : results)
+    {
+        const Statistics& s = r.statistics;
+        out << r.case_name << "," << r.dim << "," << r.distribution << "," << r.cells << ","
+            << r.occupancy << "," << r.samples << "," << s.runs << "," << s.min << ","
+            << s.mean << "," << s.median << "," << s.p90 << "," << s.p99 << "," << s.max;
+        if (options.counters)
+            for (double value : s.events)
+            {
+                out << ",";
+                if (!std::isnan(value))
+                    out << static_cast<std::uint64_t>(value);
+            }
+        out << std::endl;
+    }
+}
+
+void write_json(std::ostream& out, const Options& options, const Results& results)
+{
+    out << "{" << std::endl
+        << "  \"runs\": " << options.runs << "," << std::endl
+        << "  \"warmup\": " << options.warmup << "," << std::endl
+        << "  \"counters\": " << (options.counters ? "true" : "false") << "," << std::endl
+        << "  \"results\": [" << std::endl;
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        const Statistics& s = r.statistics;
+        out << "    {\"case\": \"" << r.case_name << "\", \"dim\": " << r.dim
+            << ", \"distribution\": \"" << r.distribution << "\", \"cells\": " << r.cells
+            << ", \"occupancy\": " << r.occupancy << ", \"samples\": " << r.samples
+            << ", \"runs\": " << s.runs << ", \"min_ms\": " << s.min << ", \"mean_ms\": " << s.mean
+            << ", \"median_ms\": " << s.median << ", \"p90_ms\": " << s.p90
+            << ", \"p99_ms\": " << s.p99 << ", \"max_ms\": " << s.max;
+        if (options.counters)
+            for (std::size_t j = 0; j < Counters::EventCount; ++j)
+            {
+                out << ", \"" << Counters::name(j) << "\": ";
+                if (std::isnan(s.events[j]))
+                    out << "null";
+                else
+                    out << static_cast<std::uint64_t>(s.events[j]);
+            }
+        out << "}"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl
+        << "}" << std::endl;
+}
+// ##########################
+// END Output
+// ##########################
+}
+
+int main(int argc, char* argv[])
+{
+    benchmark::Options options;
+    if (!benchmark::parse(argc, argv, options))
+    {
+        benchmark::usage(argv[0]);
+        return 1;
+    }
+
+    if (options.counters)
+    {
+        const benchmark::Counters probe(true);
+        for (std::size_t j = 0; j < benchmark::Counters::EventCount; ++j)
+            if (!probe.available(j))
+                std::cerr << "Counter " << benchmark::Counters::name(j) << " is not available: "
+                          << std::strerror(probe.error(j)) << std::endl;
+        if (!probe.any())
+            std::cerr << "No hardware counters, check perf_event_paranoid and the container profile."
+                      << " Timing continues without them." << std::endl;
+    }
+
+    benchmark::Results results;
+    for (std::size_t dim : options.dims)
+    {
+        switch (dim)
+        {
+        case 2: benchmark::sweep<2>(options, results); break;
+        case 3: benchmark::sweep<3>(options, results); break;
+        case 4: benchmark::sweep<4>(options, results); break;
+        default:
+            std::cerr << "Dimension " << dim << " is not supported, use 2, 3 or 4." << std::endl;
+            return 1;
+        }
+    }
+
+    if (!options.file.empty())
+    {
+        const benchmark::Dataset<3> dataset = benchmark::load(options.file);
+        if (dataset.samples.empty())
+        {
+            std::cerr << "No samples in " << options.file << "." << std::endl;
+            return 1;
+        }
+        std::cerr << "dim 3, file, " << dataset.cells << " cells, occupancy " << dataset.occupancy << std::endl;
+        benchmark::Suite<3>(options, dataset, results).run();
+    }
+
+    std::ofstream file;
+    if (!options.output.empty())
+    {
+        file.open(options.output);
+        if (!file)
+        {
+            std::cerr << "Cannot write " << options.output << "." << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+
+    switch (options.format)
+    {
+    case benchmark::Format::Text: benchmark::write_text(out, options, results); break;
+    case benchmark::Format::CSV:  benchmark::write_csv(out, options, results); break;
+    case benchmark::Format::JSON: benchmark::write_json(out, options, results); break;
+    }
+    return 0;
+}
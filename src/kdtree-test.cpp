@@ -3,10 +3,18 @@
 #include <sstream>
 #include <cmath>
 #include <chrono>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <cstdlib>
 
 #include "../include/cslibs_kdtree/kdtree.hpp"
 #include "../include/cslibs_kdtree/kdtree_dotty.hpp"
 #include "../include/cslibs_kdtree/page_clustering.hpp"
+#include "../include/cslibs_kdtree/array_clustering.hpp"
+#include "../include/cslibs_kdtree/kdtree_parallel_bulk.hpp"
 
 namespace testdata
 {
@@ -125,6 +133,21 @@ struct Index
     }
 };
 
+struct IndexPeriodic : public Index
+{
+    static constexpr int period(std::size_t dim)                            /// yaw wraps after 36 cells, x and y do not
+    {
+        return dim == 2 ? 36 : 0;
+    }
+
+    static inline Type create(const Point& pt)                              /// periodic indices have to lie in [0, period), yaw -pi is 0
+    {
+        Type index = Index::create(pt);
+        index[2] = ((index[2] + 18) % 36 + 36) % 36;
+        return index;
+    }
+};
+
 struct Data : public kdtree::KDTreeNodeClusteringSupport    /// use "kdtree::KDTreeNodeClusteringSupport" for clustering support
 {
     std::vector<const Point*> samples;
@@ -149,13 +172,58 @@ struct Data : public kdtree::KDTreeNodeClusteringSupport    /// use "kdtree::KDT
 
 using KDTreeUnbuffered      = kdtree::unbuffered::KDTree<Index, Data>;      /// unbuffered KDTree (nodes added per new)
 using ClusteringUnbuffered  = kdtree::KDTreeClustering<KDTreeUnbuffered>;
-using KDTreeBuffered        = kdtree::buffered::KDTree<Index, Data>;        /// buffered KDTree (fixed capcacity, node are in in array)
+using KDTreeBuffered        = kdtree::buffered::KDTree<Index, Data>;        /// buffered KDTree (nodes are allocated in chunks)
 using ClusteringBuffered    = kdtree::KDTreeClustering<KDTreeBuffered>;
+using KDTreeCompact         = kdtree::compact::KDTree<Index, Data>;         /// compact KDTree (index based inner nodes, leafs stored apart)
+using ClusteringCompact     = kdtree::KDTreeClustering<KDTreeCompact>;
+using KDTreeHashed          = kdtree::hashed::KDTree<Index, Data>;          /// hashed KDTree (cells in a spatial hash, no hierarchy)
+using ClusteringHashed      = kdtree::KDTreeClustering<KDTreeHashed>;
+using KDTreeMorton          = kdtree::morton::KDTree<Index, Data>;          /// morton KDTree (cells sorted by Z-order key, build once)
+using ClusteringMorton      = kdtree::KDTreeClustering<KDTreeMorton>;
+using KDTreePeriodic        = kdtree::unbuffered::KDTree<IndexPeriodic, Data>; /// unbuffered KDTree with wrapping yaw
+
+struct WeightData : public kdtree::KDTreeNodeClusteringSupport   /// data without heap members, for counting the tree's own allocations
+{
+    double weight;
+
+    inline void merge(WeightData&& other)
+    {
+        this->weight += other.weight;
+    }
+
+    static inline WeightData create(const Point& pt)
+    {
+        WeightData data;
+        data.weight = pt.weight;
+        return data;
+    }
+};
+
+using KDTreeWeight          = kdtree::unbuffered::KDTree<Index, WeightData>;
+using ClusteringWeight      = kdtree::KDTreeClustering<KDTreeWeight>;
 
 // ##########################
 // END KDTree structures
 // ##########################
 
+namespace test
+{
+std::atomic<std::size_t> allocations(0);     /// operator new calls of the whole program
+}
+
+void* operator new(std::size_t size)
+{
+    test::allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
 namespace test
 {
 struct Timer
@@ -231,6 +299,96 @@ int unbuffered_clustering(const Points& samples)
     return clustering.cluster_count();
 }
 
+int unbuffered_clustering_parallel(const Points& samples, std::size_t threads)
+{
+    KDTreeUnbuffered tree;
+    kdtree::KDTreeParallelBulkLoad<KDTreeUnbuffered> loader(tree, threads);
+
+    loader.load_bulk(samples.begin(), samples.end(), [](const Point& sample)
+    {
+        return std::make_pair(Index::create(sample), Data::create(sample));
+    });
+
+    ClusteringUnbuffered clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
+/// true if parallel and sequential bulk loading build the same tree
+bool parallel_equals_sequential(const Points& samples, std::size_t threads)
+{
+    KDTreeUnbuffered sequential;
+    for (const Point& sample : samples)
+        sequential.insert_bulk(Index::create(sample), Data::create(sample));
+    sequential.load_bulk();
+
+    KDTreeUnbuffered parallel;
+    kdtree::KDTreeParallelBulkLoad<KDTreeUnbuffered> loader(parallel, threads);
+    loader.load_bulk(samples.begin(), samples.end(), [](const Point& sample)
+    {
+        return std::make_pair(Index::create(sample), Data::create(sample));
+    });
+
+    std::vector<const KDTreeUnbuffered::NodeType*> leafs;
+    sequential.traverse_leafs([&leafs](const KDTreeUnbuffered::NodeType& node) { leafs.push_back(&node); });
+
+    std::size_t i = 0;
+    bool equal = true;
+    parallel.traverse_leafs([&](const KDTreeUnbuffered::NodeType& node)
+    {
+        equal &= i < leafs.size() &&
+                 leafs[i]->index == node.index &&
+                 leafs[i]->data.samples == node.data.samples;
+        ++i;
+    });
+    return equal && i == leafs.size();
+}
+
+int unbuffered_clustering_parallel_cluster(const Points& samples, std::size_t threads)
+{
+    KDTreeUnbuffered tree;
+
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    ClusteringUnbuffered clustering(tree);
+    clustering.cluster_parallel(threads);
+
+    return clustering.cluster_count();
+}
+
+/// true if parallel clustering labels every leaf as the serial one
+bool parallel_clustering_equals_serial(const Points& samples, std::size_t threads)
+{
+    KDTreeUnbuffered tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    ClusteringUnbuffered clustering(tree);
+    clustering.cluster();
+
+    std::vector<int> serial;
+    tree.traverse_leafs([&serial](KDTreeUnbuffered::NodeType& node)
+    {
+        serial.push_back(node.data.cluster);
+        node.data.cluster = -1;
+    });
+    const std::size_t serial_count = clustering.cluster_count();
+
+    clustering.cluster_parallel(threads);
+
+    std::size_t i = 0;
+    bool equal = true;
+    tree.traverse_leafs([&](const KDTreeUnbuffered::NodeType& node)
+    {
+        equal &= serial[i++] == node.data.cluster;
+    });
+    return equal && serial_count == clustering.cluster_count();
+}
+
 int buffered_clustering_bulk(const Points& samples, double factor)
 {
     KDTreeBuffered tree(reserve(factor, samples.size()));
@@ -258,6 +416,87 @@ int buffered_clustering(const Points& samples, double factor)
     return clustering.cluster_count();
 }
 
+int compact_clustering_bulk(const Points& samples, double factor)
+{
+    KDTreeCompact tree(reserve(factor, samples.size()));
+
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    ClusteringCompact clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
+int compact_clustering(const Points& samples, double factor)
+{
+    KDTreeCompact tree(reserve(factor, samples.size()));
+
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    ClusteringCompact clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
+int hashed_clustering_bulk(const Points& samples, double factor)
+{
+    KDTreeHashed tree(reserve(factor, samples.size()));
+
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    ClusteringHashed clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
+int hashed_clustering(const Points& samples, double factor)
+{
+    KDTreeHashed tree(reserve(factor, samples.size()));
+
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    ClusteringHashed clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
+int morton_clustering_bulk(const Points& samples, double factor)
+{
+    KDTreeMorton tree(reserve(factor, samples.size()));
+
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    ClusteringMorton clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
+int morton_clustering(const Points& samples, double factor)
+{
+    KDTreeMorton tree(reserve(factor, samples.size()));
+
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    ClusteringMorton clustering(tree);
+    clustering.cluster();
+
+    return clustering.cluster_count();
+}
+
 /// example use case for reuse and bulk loading
 template<typename Tree>
 void reuse_clustering_bulk(const Points& samples, Tree& tree)
@@ -272,6 +511,30 @@ void reuse_clustering_bulk(const Points& samples, Tree& tree)
     clustering.cluster();
 }
 
+/// true if bulk inserts stay invisible until load_bulk() and clear_bulk() drops them
+template<typename Tree>
+bool bulk_staged(const Points& samples)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+
+    std::size_t leafs = 0;
+    tree.traverse_leafs([&leafs](typename Tree::NodeType&) { ++leafs; });
+    bool staged = leafs == 0 && tree.find(Index::create(samples.front())) == nullptr;
+
+    tree.clear_bulk();
+    tree.load_bulk();
+    staged &= tree.find(Index::create(samples.front())) == nullptr;
+
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+    for (const Point& sample : samples)
+        staged &= tree.find(Index::create(sample)) != nullptr;
+    return staged;
+}
+
 /// example use case for reuse
 template<typename Tree>
 void reuse_clustering(const Points& samples, Tree& tree)
@@ -286,74 +549,1382 @@ void reuse_clustering(const Points& samples, Tree& tree)
 }
 
 template<typename Tree>
-void visualize(const Points& samples, Tree& tree, const std::string& outfile)
+void depth(const Points& samples, const std::string& prefix, bool bulk)
 {
+    Tree tree;
     for (const Point& sample : samples)
-        tree.insert(Index::create(sample), Data::create(sample));
-
-    kdtree::KDTreeClustering<Tree> clustering(tree);
-    clustering.cluster();
+    {
+        if (bulk)
+            tree.insert_bulk(Index::create(sample), Data::create(sample));
+        else
+            tree.insert(Index::create(sample), Data::create(sample));
+    }
+    tree.load_bulk();
 
-    /// Visualization command for .dot files
-    kdtree::visualize::visualize_dotty(tree, outfile);
+    kdtree::KDTreeDepthStatistics statistics = kdtree::depth_statistics(tree);
+    std::cout << prefix << ": " << statistics.leafs << " leafs, depth min " << statistics.min_depth
+              << " max " << statistics.max_depth << " mean " << statistics.mean_depth << std::endl;
 }
 
+/// clustering of an already loaded tree, labels are reset first
+template<typename Clustering>
+int cluster_only(KDTreeUnbuffered& tree, Clustering& clustering)
+{
+    tree.traverse_leafs([](KDTreeUnbuffered::NodeType& node) { node.data.cluster = -1; });
+    clustering.cluster();
+    return clustering.cluster_count();
 }
 
-int main(int argc, char* argv[])
+/// node storage of buffered::KDTree before the chunks, a vector pre-sized to the capacity
+template<typename Node>
+struct LegacyNodes
 {
-    if (argc < 2)
+    std::vector<Node> nodes;
+    std::size_t       size;
+
+    LegacyNodes(std::size_t capacity) :
+        nodes(std::max<std::size_t>(1, capacity)),
+        size(0)
     {
-        std::cout << "Usage: " << argv[0] << " <sample_data>" << std::endl;
-        return 1;
     }
 
-    std::string path = argv[1];
-    Points points = testdata::getTestdata(path);
-    Points points_small = testdata::getTestdataSmall(path);
-    std::cout << "Testdata : " << std::endl
-              << "\tFile   : " << path << std::endl
-              << "\tSamples: " << points.size() << " / " << points_small.size() << std::endl
-              << std::endl;
-
-    std::cout << "Validate: " << std::endl
-              << "\tExpected: 9 clusters" << std::endl
-              << "Runs: " << std::endl;
+    inline Node* allocate()
     {
-        auto timer  = test::Timer("\tUnbuffered Clustering       ");
-        timer.cluster =  test::unbuffered_clustering(points);
+        if (size + 1 > nodes.size())
+            throw std::length_error("Capacity to small, resize not yet implemented");
+        return &nodes[size++];
     }
+};
+
+/// operator new calls of the second of two identical frames
+template<typename F>
+std::size_t frame_allocations(F&& frame)
+{
+    frame();
+    const std::size_t before = allocations.load();
+    frame();
+    return allocations.load() - before;
+}
+
+void weight_frame_insert(const Points& samples, KDTreeWeight& tree)
+{
+    tree.clear();
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), WeightData::create(sample));
+}
+
+void weight_frame_bulk_cluster(const Points& samples, KDTreeWeight& tree, ClusteringWeight& clustering)
+{
+    tree.clear();
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), WeightData::create(sample));
+    tree.load_bulk();
+    clustering.cluster();
+}
+
+/// nodes of a frame from the legacy pre-sized vector
+std::size_t legacy_nodes(std::size_t capacity, std::size_t count)
+{
+    LegacyNodes<KDTreeBuffered::NodeType> storage(capacity);
+    for (std::size_t i = 0; i < count; ++i)
+        storage.allocate()->index[0] = static_cast<int>(i);
+    return storage.size;
+}
+
+/// nodes of a frame from a ChunkBuffer as buffered::KDTree uses it, capacity 0 grows from one chunk
+std::size_t chunk_nodes(std::size_t capacity, std::size_t count)
+{
+    kdtree::ChunkBuffer<KDTreeBuffered::NodeType> storage(KDTreeBuffered::DEFAULT_CHUNK_SIZE);
+    storage.reserve(std::max<std::size_t>(1, capacity));
+    for (std::size_t i = 0; i < count; ++i)
     {
-        auto timer  = test::Timer("\tUnbuffered Clustering (bulk)");
-        timer.cluster = test::unbuffered_clustering_bulk(points);
+        storage.reserve(i + 1);
+        storage[i].index[0] = static_cast<int>(i);
     }
+    return count;
+}
+
+/// hash used for the bulk buffers before, kept for comparison
+struct LegacyHash
+{
+    inline std::size_t operator()(const Index::Type& s) const
     {
-        auto timer  = test::Timer("\tBuffered Clustering         ");
-        timer.cluster =  test::buffered_clustering(points, 2);
+        static constexpr std::size_t SHIFT = sizeof(std::size_t) * 8 / Index::Dimension;
+        std::size_t h = std::abs(s[0]);
+        for (std::size_t i = 1; i < Index::Dimension; ++i)
+            h ^= std::abs(s[i]) << SHIFT;
+        return h;
     }
+};
+
+template<typename Map>
+void bulk_buffer_fill(const Points& samples, Map& buffer)
+{
+    buffer.clear();
+    for (const Point& sample : samples)
     {
-        auto timer  = test::Timer("\tBuffered Clustering (bulk)  ");
-        timer.cluster = test::buffered_clustering_bulk(points, 2);
+        Data data = Data::create(sample);
+        auto entry = buffer.emplace(Index::create(sample), std::move(data));
+        if (!entry.second)
+            entry.first->merge(std::move(data));
     }
+}
 
-    std::cout << std::endl
-              << "Timings: " << std::endl
-              << "\tExpected: bulk faster than non-bulk" << std::endl
-              << "\tExpected: buffered faster than un-buffered" << std::endl
-              << "Runs: " << std::endl;
+template<typename Hash>
+void bulk_buffer_statistics(const Points& samples, const std::string& prefix)
+{
+    kdtree::FlatHashMap<Index::Type, Data, Hash, true> buffer;
+    bulk_buffer_fill(samples, buffer);                  /// grow to the final size first
+    buffer.reset_statistics();
+    bulk_buffer_fill(samples, buffer);
+    const kdtree::FlatHashMapStatistics& statistics = buffer.statistics();
+    std::cout << prefix << ": " << buffer.size() << " cells in " << buffer.bucket_count() << " slots, "
+              << statistics.collisions << " collisions, "
+              << static_cast<double>(statistics.probes) / statistics.lookups << " probes per lookup" << std::endl;
+}
+
+/// lookup of every sample cell in a loaded tree
+template<typename Tree>
+std::size_t find_all(const Points& samples, Tree& tree)
+{
+    std::size_t found = 0;
+    for (const Point& sample : samples)
+        found += tree.find(Index::create(sample)) != nullptr;
+    return found;
+}
+
+/// neighbours of every leaf with a separate find per offset, as before the shared descent
+template<typename Tree, typename Connectivity = kdtree::ConnectivityFull>
+std::size_t neighbours_find(Tree& tree)
+{
+    using Neighbourhood = kdtree::KDTreeIndexNeigbourhood<Tree, Index, Connectivity>;
+    typename Neighbourhood::MaskType offsets;
+    Neighbourhood::MaskFiller::assign(offsets);
+
+    std::size_t found = 0;
+    tree.traverse_leafs([&](typename Tree::NodeType& node)
     {
-        test::Benchmark::timing<500>("\tUnbuffered       ", std::bind(&test::unbuffered_clustering, points));
-        test::Benchmark::timing<500>("\tUnbuffered (bulk)", std::bind(&test::unbuffered_clustering_bulk, points));
-        test::Benchmark::timing<500>("\tBuffered         ", std::bind(&test::buffered_clustering, points, 0.2));
-        test::Benchmark::timing<500>("\tBuffered   (bulk)", std::bind(&test::buffered_clustering_bulk, points, 0.2));
-    }
+        for (const Index::Type& offset : offsets)
+        {
+            if (offset == Index::Type())
+                continue;
+
+            Index::Type index;
+            for (std::size_t i = 0; i < Index::Dimension; ++i)
+                index[i] = node.index[i] + offset[i];
+            found += tree.find(index) != nullptr;
+        }
+    });
+    return found;
+}
+
+template<typename Tree, typename Connectivity = kdtree::ConnectivityFull>
+std::size_t neighbours_visit(Tree& tree, bool half)
+{
+    kdtree::KDTreeIndexNeigbourhood<Tree, Index, Connectivity> neighbourhood(tree);
+
+    std::size_t found = 0;
+    auto count = [&found](typename Tree::NodeType&) { ++found; };
+    tree.traverse_leafs([&](typename Tree::NodeType& node)
     {
-        KDTreeUnbuffered unbuffered;
-        KDTreeBuffered buffered(test::reserve(0.2, points.size()));
-        test::Benchmark::timing<500>("\tUnbuffered        (reuse): ", std::bind(&test::reuse_clustering<KDTreeUnbuffered>, std::cref(points), std::ref(unbuffered)));
-        test::Benchmark::timing<500>("\tUnbuffered (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeUnbuffered>, points, std::ref(unbuffered)));
-        test::Benchmark::timing<500>("\tBuffered          (reuse): ", std::bind(&test::reuse_clustering<KDTreeBuffered>, points, std::ref(buffered)));
-        test::Benchmark::timing<500>("\tBuffered   (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeBuffered>, points, std::ref(buffered)));
+        if (half)
+            neighbourhood.visit_half(node.index, count);
+        else
+            neighbourhood.visit(node.index, count);
+    });
+    return found;
+}
+
+template<typename Tree>
+void neighbours(const Points& samples, Tree& tree, const std::string& prefix)
+{
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    const std::size_t find = neighbours_find(tree);
+    const std::size_t full = neighbours_visit(tree, false);
+    const std::size_t half = neighbours_visit(tree, true);
+    std::cout << prefix << ": " << full << " neighbours, equal to find: " << (full == find ? "yes" : "no")
+              << ", half: " << (2 * half == full ? "yes" : "no") << std::endl;
+
+    /// the counts are kept, otherwise lookups without side effects may be optimized out
+    volatile std::size_t sink = 0;
+    test::Benchmark::timing<500>(prefix + " (find) ", [&]() { sink = sink + neighbours_find(tree); });
+    test::Benchmark::timing<500>(prefix + " (visit)", [&]() { sink = sink + neighbours_visit(tree, false); });
+    test::Benchmark::timing<500>(prefix + " (half) ", [&]() { sink = sink + neighbours_visit(tree, true); });
+}
+
+/// true if grid clustering labels every leaf as the tree clustering, path tells which one ran
+template<typename Tree, typename Connectivity = kdtree::ConnectivityFull>
+bool grid_clustering_equals_tree(const Points& samples, std::size_t threshold, bool& used_grid)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(Tree::IndexTraits::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    kdtree::KDTreeClustering<Tree, kdtree::KDTreeClusteringAccept, kdtree::KDTreeClusteringAccept, Connectivity> clustering(tree);
+    clustering.cluster();
+
+    std::vector<int> labels;
+    tree.traverse_leafs([&labels](typename Tree::NodeType& node)
+    {
+        labels.push_back(node.data.cluster);
+        node.data.cluster = -1;
+    });
+
+    kdtree::KDTreeGridClustering<Tree, kdtree::KDTreeClusteringAccept, kdtree::KDTreeClusteringAccept, Connectivity> grid(tree);
+    grid.set_grid_threshold(threshold);
+    grid.cluster();
+    used_grid = grid.used_grid();
+
+    std::size_t i = 0;
+    bool equal = true;
+    tree.traverse_leafs([&](const typename Tree::NodeType& node)
+    {
+        equal &= labels[i++] == node.data.cluster;
+    });
+    return equal && clustering.cluster_count() == grid.cluster_count();
+}
+
+template<typename Tree>
+void grid_clustering(const Points& samples, const std::string& prefix)
+{
+    for (std::size_t threshold : {kdtree::KDTreeGridClustering<Tree>::DEFAULT_GRID_THRESHOLD, std::size_t(0)})
+    {
+        bool used_grid = false;
+        const bool equal = grid_clustering_equals_tree<Tree>(samples, threshold, used_grid);
+        std::cout << prefix << " threshold " << threshold << ": " << (used_grid ? "grid" : "tree")
+                  << ", equal to tree: " << (equal ? "yes" : "no") << std::endl;
+    }
+}
+
+/// clustering of an already loaded tree, labels are reset first
+template<typename Tree, typename Clustering>
+int grid_cluster_only(Tree& tree, Clustering& clustering)
+{
+    tree.traverse_leafs([](typename Tree::NodeType& node) { node.data.cluster = -1; });
+    clustering.cluster();
+    return clustering.cluster_count();
+}
+
+template<typename Tree>
+using IncrementalClustering = kdtree::KDTreeIncrementalClustering<Tree>;
+
+/// true if the incremental clusters partition the leafs as cluster() does
+template<typename Tree>
+bool incremental_equals_batch(const Points& samples, std::size_t& count)
+{
+    Tree tree;
+    IncrementalClustering<Tree> incremental(tree);
+    for (const Point& sample : samples)
+        incremental.insert(Tree::IndexTraits::create(sample), Data::create(sample));
+
+    std::vector<int> ids;
+    tree.traverse_leafs([&ids, &incremental](typename Tree::NodeType& node)
+    {
+        ids.push_back(incremental.cluster(node));
+        node.data.cluster = -1;
+    });
+    count = incremental.cluster_count();
+
+    kdtree::KDTreeClustering<Tree> clustering(tree);
+    clustering.cluster();
+
+    std::map<int, int> to_batch;
+    std::map<int, int> to_incremental;
+    std::size_t i = 0;
+    bool equal = true;
+    tree.traverse_leafs([&](const typename Tree::NodeType& node)
+    {
+        const int id = ids[i++];
+        equal &= to_batch.emplace(id, node.data.cluster).first->second == node.data.cluster;
+        equal &= to_incremental.emplace(node.data.cluster, id).first->second == id;
+    });
+    return equal && count == clustering.cluster_count();
+}
+
+template<typename Tree>
+void incremental_clustering(const Points& samples, const std::string& prefix)
+{
+    std::size_t count = 0;
+    const bool equal = incremental_equals_batch<Tree>(samples, count);
+    std::cout << prefix << ": " << count << " cluster, equal to batch: " << (equal ? "yes" : "no") << std::endl;
+}
+
+/// samples arrive in cycles, the clustering is read after every cycle
+int cycles_batch(const Points& samples, std::size_t cycles)
+{
+    KDTreeUnbuffered tree;
+    ClusteringUnbuffered clustering(tree);
+    const std::size_t block = (samples.size() + cycles - 1) / cycles;
+    for (std::size_t i = 0; i < samples.size(); i += block)
+    {
+        const std::size_t end = std::min(samples.size(), i + block);
+        for (std::size_t j = i; j < end; ++j)
+            tree.insert(Index::create(samples[j]), Data::create(samples[j]));
+
+        tree.traverse_leafs([](KDTreeUnbuffered::NodeType& node) { node.data.cluster = -1; });
+        clustering.cluster();
+    }
+    return clustering.cluster_count();
+}
+
+int cycles_incremental(const Points& samples, std::size_t cycles)
+{
+    KDTreeUnbuffered tree;
+    IncrementalClustering<KDTreeUnbuffered> clustering(tree);
+    const std::size_t block = (samples.size() + cycles - 1) / cycles;
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < samples.size(); i += block)
+    {
+        const std::size_t end = std::min(samples.size(), i + block);
+        for (std::size_t j = i; j < end; ++j)
+            clustering.insert(Index::create(samples[j]), Data::create(samples[j]));
+
+        count = clustering.cluster_count();
+    }
+    return static_cast<int>(count);
+}
+
+/// knn queries next to the sample cells, shifted so that most are not occupied
+std::vector<Index::Type> knn_queries(const Points& samples, std::size_t count)
+{
+    std::vector<Index::Type> queries;
+    const std::size_t step = std::max<std::size_t>(1, samples.size() / count);
+    for (std::size_t i = 0; i < samples.size() && queries.size() < count; i += step)
+    {
+        Index::Type index = Index::create(samples[i]);
+        index[0] += static_cast<int>(i % 7) - 3;
+        index[1] += static_cast<int>(i % 5) - 2;
+        queries.push_back(index);
+    }
+    return queries;
+}
+
+/// k nearest cells by scanning all leafs
+template<typename Tree>
+void knn_brute_force(Tree& tree, const Index::Type& query, std::size_t k, typename Tree::KnnResultType& result)
+{
+    using Nearest = typename Tree::Nearest;
+    result.clear();
+    tree.traverse_leafs([&](typename Tree::NodeType& node)
+    {
+        result.emplace_back(Nearest::squared_distance(node.index, query), &node);
+    });
+    k = std::min(k, result.size());
+    std::partial_sort(result.begin(), result.begin() + k, result.end(),
+                      [](const typename Nearest::EntryType& a, const typename Nearest::EntryType& b) { return a.first < b.first; });
+    result.resize(k);
+}
+
+/// true if every knn result has the distances of the brute force scan
+template<typename Tree>
+bool knn_equals_brute_force(Tree& tree, const std::vector<Index::Type>& queries, std::size_t k)
+{
+    typename Tree::KnnResultType result;
+    typename Tree::KnnResultType expected;
+    bool equal = true;
+    for (const Index::Type& query : queries)
+    {
+        tree.knn(query, k, result);
+        knn_brute_force(tree, query, k, expected);
+        equal &= result.size() == expected.size();
+        for (std::size_t i = 0; equal && i < result.size(); ++i)
+            equal &= result[i].first == expected[i].first;
+    }
+    return equal;
+}
+
+template<typename Tree>
+double knn_all(Tree& tree, const std::vector<Index::Type>& queries, std::size_t k, typename Tree::KnnResultType& result)
+{
+    double sum = 0.0;
+    for (const Index::Type& query : queries)
+    {
+        tree.knn(query, k, result);
+        sum += result.back().first;
+    }
+    return sum;
+}
+
+template<typename Tree>
+double knn_brute_force_all(Tree& tree, const std::vector<Index::Type>& queries, std::size_t k, typename Tree::KnnResultType& result)
+{
+    double sum = 0.0;
+    for (const Index::Type& query : queries)
+    {
+        knn_brute_force(tree, query, k, result);
+        sum += result.back().first;
+    }
+    return sum;
+}
+
+template<typename Tree>
+void knn(const Points& samples, const std::string& prefix)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    const std::vector<Index::Type> queries = knn_queries(samples, 200);
+    for (std::size_t k : {std::size_t(1), std::size_t(8)})
+        std::cout << prefix << " k = " << k << " equal to brute force: " << (knn_equals_brute_force(tree, queries, k) ? "yes" : "no") << std::endl;
+
+    typename Tree::KnnResultType result;
+    test::Benchmark::timing<20>(prefix + " knn        ", std::bind(&knn_all<Tree>, std::ref(tree), std::cref(queries), 8, std::ref(result)));
+    test::Benchmark::timing<20>(prefix + " brute force", std::bind(&knn_brute_force_all<Tree>, std::ref(tree), std::cref(queries), 8, std::ref(result)));
+}
+
+/// bounds of all cells
+template<typename Tree>
+void cell_bounds(Tree& tree, Index::Type& min, Index::Type& max)
+{
+    min.fill(std::numeric_limits<int>::max());
+    max.fill(std::numeric_limits<int>::min());
+    tree.traverse_leafs([&](const typename Tree::NodeType& node)
+    {
+        for (std::size_t i = 0; i < Index::Dimension; ++i)
+        {
+            min[i] = std::min(min[i], node.index[i]);
+            max[i] = std::max(max[i], node.index[i]);
+        }
+    });
+}
+
+/// central quarter of the xy extent of the cells over the full z range
+template<typename Tree>
+void central_box(Tree& tree, Index::Type& min, Index::Type& max)
+{
+    cell_bounds(tree, min, max);
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        const int extent = max[i] - min[i];
+        min[i] += 3 * extent / 8;
+        max[i] -= 3 * extent / 8;
+    }
+}
+
+/// box over the upper xy corner of the cells reaching margin cells beyond it, mostly empty
+template<typename Tree>
+void corner_box(Tree& tree, int margin, Index::Type& min, Index::Type& max)
+{
+    cell_bounds(tree, min, max);
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+        min[i] = max[i] - 4;
+        max[i] += margin;
+    }
+}
+
+template<typename Tree>
+std::size_t box_query(Tree& tree, const Index::Type& min, const Index::Type& max)
+{
+    std::size_t count = 0;
+    tree.query_box(min, max, [&count](typename Tree::NodeType&) { ++count; });
+    return count;
+}
+
+template<typename Tree>
+std::size_t box_traverse(Tree& tree, const Index::Type& min, const Index::Type& max)
+{
+    std::size_t count = 0;
+    tree.traverse_leafs([&](typename Tree::NodeType& node)
+    {
+        bool inside = true;
+        for (std::size_t i = 0; i < Index::Dimension; ++i)
+            inside &= min[i] <= node.index[i] && node.index[i] <= max[i];
+        count += inside;
+    });
+    return count;
+}
+
+template<typename Tree>
+std::size_t box_find(Tree& tree, const Index::Type& min, const Index::Type& max)
+{
+    std::size_t count = 0;
+    Index::Type index;
+    for (index[0] = min[0]; index[0] <= max[0]; ++index[0])
+        for (index[1] = min[1]; index[1] <= max[1]; ++index[1])
+            for (index[2] = min[2]; index[2] <= max[2]; ++index[2])
+                count += tree.find(index) != nullptr;
+    return count;
+}
+
+template<typename Tree>
+std::size_t radius_query(Tree& tree, const std::vector<Index::Type>& centers, double radius)
+{
+    std::size_t count = 0;
+    for (const Index::Type& center : centers)
+        tree.query_radius(center, radius, [&count](typename Tree::NodeType&) { ++count; });
+    return count;
+}
+
+template<typename Tree>
+std::size_t radius_traverse(Tree& tree, const std::vector<Index::Type>& centers, double radius)
+{
+    std::size_t count = 0;
+    for (const Index::Type& center : centers)
+        tree.traverse_leafs([&](typename Tree::NodeType& node)
+        {
+            count += Tree::Nearest::squared_distance(node.index, center) <= radius * radius;
+        });
+    return count;
+}
+
+template<typename Tree>
+void range(const Points& samples, const std::string& prefix)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    Index::Type min;
+    Index::Type max;
+    const std::vector<Index::Type> centers = knn_queries(samples, 200);
+    bool equal = true;
+    for (int box = 0; box < 2; ++box)
+    {
+        if (box == 0)
+            central_box(tree, min, max);
+        else
+            corner_box(tree, 40, min, max);
+        equal &= box_query(tree, min, max) == box_traverse(tree, min, max);
+        equal &= box_query(tree, min, max) == box_find(tree, min, max);
+    }
+    for (double radius : {0.0, 1.0, 2.5, 6.0})
+        equal &= radius_query(tree, centers, radius) == radius_traverse(tree, centers, radius);
+    std::cout << prefix << " equal to scan: " << (equal ? "yes" : "no") << std::endl;
+
+    volatile std::size_t sink = 0;
+    test::Benchmark::timing<100>(prefix + " box    (query)   ", [&]() { sink = sink + box_query(tree, min, max); });
+    test::Benchmark::timing<100>(prefix + " box    (traverse)", [&]() { sink = sink + box_traverse(tree, min, max); });
+    test::Benchmark::timing<100>(prefix + " box    (find)    ", [&]() { sink = sink + box_find(tree, min, max); });
+    test::Benchmark::timing<100>(prefix + " radius (query)   ", [&]() { sink = sink + radius_query(tree, centers, 2.5); });
+    test::Benchmark::timing<100>(prefix + " radius (traverse)", [&]() { sink = sink + radius_traverse(tree, centers, 2.5); });
+}
+
+template<typename Connectivity>
+void connectivity(KDTreeUnbuffered& tree, const Points& samples, const std::string& prefix)
+{
+    using Clustering = kdtree::KDTreeClustering<KDTreeUnbuffered, kdtree::KDTreeClusteringAccept, kdtree::KDTreeClusteringAccept, Connectivity>;
+    using Neighbourhood = kdtree::KDTreeIndexNeigbourhood<KDTreeUnbuffered, Index, Connectivity>;
+
+    Clustering clustering(tree);
+    tree.traverse_leafs([](KDTreeUnbuffered::NodeType& node) { node.data.cluster = -1; });
+    clustering.cluster();
+
+    const std::size_t find = neighbours_find<KDTreeUnbuffered, Connectivity>(tree);
+    const std::size_t full = neighbours_visit<KDTreeUnbuffered, Connectivity>(tree, false);
+    const std::size_t half = neighbours_visit<KDTreeUnbuffered, Connectivity>(tree, true);
+    bool used_grid = false;
+    const bool grid = grid_clustering_equals_tree<KDTreeUnbuffered, Connectivity>(samples, 1 << 20, used_grid);
+    std::cout << prefix << ": " << Neighbourhood::Size << " offsets, " << clustering.cluster_count() << " cluster"
+              << ", equal to find: " << (full == find ? "yes" : "no")
+              << ", half: " << (2 * half == full ? "yes" : "no")
+              << ", grid equal: " << (grid ? "yes" : "no") << std::endl;
+
+    test::Benchmark::timing<500>(prefix + " clustering", std::bind(&test::cluster_only<Clustering>, std::ref(tree), std::ref(clustering)));
+}
+
+/// weight and index of a cell for the cluster moments
+struct CellSample
+{
+    inline double operator()(const KDTreeUnbuffered::NodeType& node, std::array<double, Index::Dimension>& position) const
+    {
+        for (std::size_t i = 0; i < Index::Dimension; ++i)
+            position[i] = node.index[i];
+        return node.data.weight;
+    }
+};
+
+using ClusterMoments = kdtree::KDTreeClusterMoments<Index::Dimension, CellSample>;
+
+/// moments in a second pass over the leafs, bucketed through a map
+void moments_second_pass(KDTreeUnbuffered& tree, ClusterMoments& moments)
+{
+    std::map<int, std::size_t> rows;
+    moments.clear();
+    tree.traverse_leafs([&rows, &moments](const KDTreeUnbuffered::NodeType& node)
+    {
+        if (node.data.cluster < 0)
+            return;
+
+        auto row = rows.find(node.data.cluster);
+        if (row == rows.end())
+        {
+            row = rows.emplace(node.data.cluster, moments.size()).first;
+            moments.add_cluster();
+        }
+        moments.add(row->second, node);
+    });
+}
+
+std::size_t moments_two_pass(KDTreeUnbuffered& tree, ClusteringUnbuffered& clustering, ClusterMoments& moments)
+{
+    tree.traverse_leafs([](KDTreeUnbuffered::NodeType& node) { node.data.cluster = -1; });
+    clustering.cluster();
+    moments_second_pass(tree, moments);
+    return moments.size();
+}
+
+std::size_t moments_one_pass(KDTreeUnbuffered& tree, ClusteringUnbuffered& clustering, ClusterMoments& moments)
+{
+    tree.traverse_leafs([](KDTreeUnbuffered::NodeType& node) { node.data.cluster = -1; });
+    clustering.cluster(moments);
+    return moments.size();
+}
+
+/// true if the moments gathered while clustering equal the ones of a second pass
+bool moments_equal_second_pass(KDTreeUnbuffered& tree, ClusteringUnbuffered& clustering)
+{
+    ClusterMoments one;
+    ClusterMoments two;
+    moments_one_pass(tree, clustering, one);
+    moments_second_pass(tree, two);
+
+    /// the second pass numbers rows by first leaf, so map them through a cell of each cluster
+    std::vector<std::size_t> row_of(one.size(), one.size());
+    std::map<int, std::size_t> rows;
+    tree.traverse_leafs([&](const KDTreeUnbuffered::NodeType& node)
+    {
+        if (node.data.cluster >= 0 && rows.count(node.data.cluster) == 0)
+        {
+            const std::size_t row = rows.size();
+            rows.emplace(node.data.cluster, row);
+            row_of[node.data.cluster] = row;
+        }
+    });
+
+    bool equal = one.size() == two.size() && one.size() == clustering.cluster_count();
+    for (std::size_t c = 0; equal && c < one.size(); ++c)
+    {
+        const std::size_t r = row_of[c];
+        const ClusterMoments::PositionType mean_one = one.mean(c);
+        const ClusterMoments::PositionType mean_two = two.mean(r);
+        const ClusterMoments::CovarianceType cov_one = one.covariance(c);
+        const ClusterMoments::CovarianceType cov_two = two.covariance(r);
+        equal &= one.cells[c] == two.cells[r];
+        equal &= std::abs(one.weights[c] - two.weights[r]) <= 1e-9 * std::abs(two.weights[r]);
+        for (std::size_t i = 0; i < mean_one.size(); ++i)
+            equal &= std::abs(mean_one[i] - mean_two[i]) <= 1e-6;
+        for (std::size_t i = 0; i < cov_one.size(); ++i)
+            equal &= std::abs(cov_one[i] - cov_two[i]) <= 1e-6;
+    }
+    return equal;
+}
+
+/// cells dropped by the erase runs
+inline bool erased_cell(const Index::Type& index)
+{
+    return (index[0] + index[1]) % 3 == 0;
+}
+
+/// true if erasing cells leaves the tree equal to one built without them
+template<typename Tree>
+bool erase_equals_filtered(const Points& samples, bool bulk)
+{
+    Tree tree;
+    Tree filtered;
+    for (const Point& sample : samples)
+    {
+        const Index::Type index = Index::create(sample);
+        if (bulk)
+            tree.insert_bulk(index, Data::create(sample));
+        else
+            tree.insert(index, Data::create(sample));
+        if (!erased_cell(index))
+            filtered.insert(index, Data::create(sample));
+    }
+    tree.load_bulk();
+
+    tree.erase_if([](const typename Tree::NodeType& node) { return erased_cell(node.index); });
+
+    std::size_t leafs = 0;
+    std::size_t filtered_leafs = 0;
+    bool equal = true;
+    tree.traverse_leafs([&leafs](const typename Tree::NodeType&) { ++leafs; });
+    filtered.traverse_leafs([&](const typename Tree::NodeType& node)
+    {
+        const typename Tree::NodeType* found = tree.find(node.index);
+        equal &= found != nullptr && found->data.weight == node.data.weight;
+        ++filtered_leafs;
+    });
+
+    kdtree::KDTreeClustering<Tree> clustering(tree);
+    kdtree::KDTreeClustering<Tree> filtered_clustering(filtered);
+    clustering.cluster();
+    filtered_clustering.cluster();
+    return equal && leafs == filtered_leafs && clustering.cluster_count() == filtered_clustering.cluster_count();
+}
+
+/// true if decay erases exactly the cells whose decayed weight is below the threshold
+template<typename Tree>
+bool decay_equals_expected(const Points& samples)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    std::vector<double> weights;
+    tree.traverse_leafs([&weights](const typename Tree::NodeType& node) { weights.push_back(0.5 * node.data.weight); });
+    std::nth_element(weights.begin(), weights.begin() + weights.size() / 2, weights.end());
+    const double threshold = weights[weights.size() / 2];
+    const std::size_t expected = static_cast<std::size_t>(
+                std::count_if(weights.begin(), weights.end(), [threshold](double w) { return w < threshold; }));
+
+    const std::size_t erased = kdtree::decay(tree, 0.5, threshold, [](Data& data) -> double& { return data.weight; });
+
+    std::size_t leafs = 0;
+    bool above = true;
+    tree.traverse_leafs([&](const typename Tree::NodeType& node)
+    {
+        above &= node.data.weight >= threshold;
+        ++leafs;
+    });
+    return above && erased == expected && leafs == weights.size() - expected;
+}
+
+template<typename Tree>
+void erase(const Points& samples, const std::string& prefix)
+{
+    std::cout << prefix << " erase equal to filtered       : " << (erase_equals_filtered<Tree>(samples, false) ? "yes" : "no") << std::endl;
+    std::cout << prefix << " erase equal to filtered (bulk): " << (erase_equals_filtered<Tree>(samples, true) ? "yes" : "no") << std::endl;
+    std::cout << prefix << " decay equal to expected       : " << (decay_equals_expected<Tree>(samples) ? "yes" : "no") << std::endl;
+}
+
+/// a third of the cells leaves the window, the tree is updated in place
+template<typename Tree>
+std::size_t window_erase(const Points& samples)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+    return tree.erase_if([](const typename Tree::NodeType& node) { return erased_cell(node.index); });
+}
+
+/// the same window with the tree rebuilt from the remaining samples
+template<typename Tree>
+std::size_t window_rebuild(const Points& samples)
+{
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(Index::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    tree.clear();
+    for (const Point& sample : samples)
+    {
+        const Index::Type index = Index::create(sample);
+        if (!erased_cell(index))
+            tree.insert_bulk(index, Data::create(sample));
+    }
+    tree.load_bulk();
+    return 0;
+}
+
+/// occupied cells of the samples for PageClustering
+struct PageCell
+{
+    Index::Type index;
+    int cluster;
+};
+
+struct PageCells
+{
+    std::vector<PageCell>  cells;
+    std::vector<PageCell*> entries;
+    Index::Type            min_index;
+    Index::Type            max_index;
+};
+
+template<typename Tree = KDTreeUnbuffered>
+void page_cells(const Points& samples, PageCells& result)
+{
+    using IndexTraits = typename Tree::IndexTraits;
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(IndexTraits::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    result.min_index = tree.get_min_index();
+    result.max_index = tree.get_max_index();
+    tree.traverse_leafs([&result](const typename Tree::NodeType& node)
+    {
+        result.cells.push_back(PageCell{node.index, -1});
+    });
+    for (PageCell& cell : result.cells)
+        result.entries.push_back(&cell);
+}
+
+using PageClustering = kdtree::PageClustering<PageCell, Index::Dimension>;
+
+/// page clustering of the cells, a fresh page is allocated if none is passed
+template<typename Clustering = PageClustering>
+int page_clustering(PageCells& cells, typename Clustering::PageType* page)
+{
+    typename Clustering::PageType::Size size;
+    for (std::size_t i = 0; i < Index::Dimension; ++i)
+        size[i] = static_cast<std::size_t>(cells.max_index[i] - cells.min_index[i]) + 1;
+
+    std::unique_ptr<typename Clustering::PageType> fresh;
+    if (page)
+    {
+        page->reset(size);
+    }
+    else
+    {
+        fresh.reset(new typename Clustering::PageType(size));
+        page = fresh.get();
+    }
+
+    typename Clustering::PageType::Index index;
+    for (PageCell* cell : cells.entries)
+    {
+        cell->cluster = -1;
+        for (std::size_t i = 0; i < Index::Dimension; ++i)
+            index[i] = static_cast<std::size_t>(cell->index[i] - cells.min_index[i]);
+        page->at(index) = cell;
+    }
+
+    Clustering clustering(cells.entries, *page, cells.min_index, cells.max_index);
+    clustering.cluster();
+
+    int count = 0;
+    for (const PageCell* cell : cells.entries)
+        count = std::max(count, cell->cluster + 1);
+    return count;
+}
+
+/// array clustering of the cells
+template<typename Clustering>
+int array_clustering(PageCells& cells)
+{
+    kdtree::Array<PageCell*, Index::Dimension>::Size size;
+    for (std::size_t i = 0; i < Index::Dimension; ++i)
+        size[i] = static_cast<std::size_t>(cells.max_index[i] - cells.min_index[i]) + 1;
+    kdtree::Array<PageCell*, Index::Dimension> array(size);
+    array.reset(nullptr);
+
+    kdtree::Array<PageCell*, Index::Dimension>::Index index;
+    for (PageCell* cell : cells.entries)
+    {
+        cell->cluster = -1;
+        for (std::size_t i = 0; i < Index::Dimension; ++i)
+            index[i] = static_cast<std::size_t>(cell->index[i] - cells.min_index[i]);
+        array.at(index) = cell;
+    }
+
+    Clustering clustering(cells.entries, array, cells.min_index, cells.max_index);
+    clustering.cluster();
+
+    int count = 0;
+    for (const PageCell* cell : cells.entries)
+        count = std::max(count, cell->cluster + 1);
+    return count;
+}
+
+/// the samples turned in yaw so that every cloud straddles +-pi
+Points turned(const Points& samples, double yaw)
+{
+    Points result = samples;
+    for (Point& sample : result)
+    {
+        sample.z += yaw;
+        while (sample.z >= M_PI)
+            sample.z -= 2.0 * M_PI;
+        while (sample.z < -M_PI)
+            sample.z += 2.0 * M_PI;
+    }
+    return result;
+}
+
+template<typename Tree>
+std::size_t tree_cluster_count(const Points& samples)
+{
+    using IndexTraits = typename Tree::IndexTraits;
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(IndexTraits::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    kdtree::KDTreeClustering<Tree> clustering(tree);
+    clustering.cluster();
+    return clustering.cluster_count();
+}
+
+template<typename Tree>
+void periodic(const Points& samples, const std::string& prefix)
+{
+    using IndexTraits = typename Tree::IndexTraits;
+    Tree tree;
+    for (const Point& sample : samples)
+        tree.insert_bulk(IndexTraits::create(sample), Data::create(sample));
+    tree.load_bulk();
+
+    kdtree::KDTreeClustering<Tree> clustering(tree);
+    clustering.cluster_parallel(4);
+    std::cout << prefix << " serial / parallel: " << tree_cluster_count<Tree>(samples) << " / " << clustering.cluster_count() << " cluster" << std::endl;
+
+    bool used_grid = false;
+    std::cout << prefix << " grid equal to tree: " << (grid_clustering_equals_tree<Tree>(samples, kdtree::KDTreeGridClustering<Tree>::DEFAULT_GRID_THRESHOLD, used_grid) ? "yes" : "no") << std::endl;
+
+    std::size_t count = 0;
+    const bool equal = incremental_equals_batch<Tree>(samples, count);
+    std::cout << prefix << " incremental: " << count << " cluster, equal to batch: " << (equal ? "yes" : "no") << std::endl;
+}
+
+/// neighbourhood indices of every sample cell
+template<typename AO>
+int index_math(const Points& samples)
+{
+    using Mask = kdtree::ConnectivityFull::Mask<Index::Type, Index::Dimension>;
+    static Mask::Type offsets;
+    static bool filled = (Mask::assign(offsets), true);
+    (void) filled;
+
+    Mask::Type neighbours;
+    int sum = 0;
+    for (const Point& sample : samples)
+    {
+        AO::add_each(Index::create(sample), offsets.data(), neighbours.data(), offsets.size());
+        sum += neighbours.back()[0];
+    }
+    return sum;
+}
+
+template<typename Tree>
+void visualize(const Points& samples, Tree& tree, const std::string& outfile)
+{
+    for (const Point& sample : samples)
+        tree.insert(Index::create(sample), Data::create(sample));
+
+    kdtree::KDTreeClustering<Tree> clustering(tree);
+    clustering.cluster();
+
+    /// Visualization command for .dot files
+    kdtree::visualize::visualize_dotty(tree, outfile);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <sample_data>" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[1];
+    Points points = testdata::getTestdata(path);
+    Points points_small = testdata::getTestdataSmall(path);
+    std::cout << "Testdata : " << std::endl
+              << "\tFile   : " << path << std::endl
+              << "\tSamples: " << points.size() << " / " << points_small.size() << std::endl
+              << std::endl;
+
+    std::cout << "Node size: " << std::endl
+              << "\tBuffered / Unbuffered node: " << sizeof(KDTreeBuffered::NodeType) << " bytes" << std::endl
+              << "\tCompact inner node        : " << sizeof(KDTreeCompact::InnerNodeType) << " bytes" << std::endl
+              << "\tCompact leaf              : " << sizeof(KDTreeCompact::NodeType) << " bytes" << std::endl
+              << std::endl;
+
+    std::cout << "Validate: " << std::endl
+              << "\tExpected: 9 clusters" << std::endl
+              << "Runs: " << std::endl;
+    {
+        auto timer  = test::Timer("\tUnbuffered Clustering       ");
+        timer.cluster =  test::unbuffered_clustering(points);
+    }
+    {
+        auto timer  = test::Timer("\tUnbuffered Clustering (bulk)");
+        timer.cluster = test::unbuffered_clustering_bulk(points);
+    }
+    {
+        auto timer  = test::Timer("\tBuffered Clustering         ");
+        timer.cluster =  test::buffered_clustering(points, 2);
+    }
+    {
+        auto timer  = test::Timer("\tBuffered Clustering (bulk)  ");
+        timer.cluster = test::buffered_clustering_bulk(points, 2);
+    }
+    {
+        auto timer  = test::Timer("\tCompact Clustering          ");
+        timer.cluster =  test::compact_clustering(points, 0.2);
+    }
+    {
+        auto timer  = test::Timer("\tCompact Clustering (bulk)   ");
+        timer.cluster = test::compact_clustering_bulk(points, 0.2);
+    }
+    {
+        auto timer  = test::Timer("\tHashed Clustering           ");
+        timer.cluster =  test::hashed_clustering(points, 0.2);
+    }
+    {
+        auto timer  = test::Timer("\tHashed Clustering (bulk)    ");
+        timer.cluster = test::hashed_clustering_bulk(points, 0.2);
+    }
+    {
+        auto timer  = test::Timer("\tMorton Clustering           ");
+        timer.cluster =  test::morton_clustering(points, 0.2);
+    }
+    {
+        auto timer  = test::Timer("\tMorton Clustering (bulk)    ");
+        timer.cluster = test::morton_clustering_bulk(points, 0.2);
+    }
+
+    std::cout << std::endl
+              << "Depth: " << std::endl
+              << "\tExpected: bulk shallower than non-bulk" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::depth<KDTreeUnbuffered>(points, "\tUnbuffered       ", false);
+        test::depth<KDTreeUnbuffered>(points, "\tUnbuffered (bulk)", true);
+        test::depth<KDTreeBuffered>(points, "\tBuffered         ", false);
+        test::depth<KDTreeBuffered>(points, "\tBuffered   (bulk)", true);
+    }
+
+    std::cout << std::endl
+              << "Timings: " << std::endl
+              << "\tExpected: bulk faster than non-bulk" << std::endl
+              << "\tExpected: buffered faster than un-buffered" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::Benchmark::timing<500>("\tUnbuffered       ", std::bind(&test::unbuffered_clustering, points));
+        test::Benchmark::timing<500>("\tUnbuffered (bulk)", std::bind(&test::unbuffered_clustering_bulk, points));
+        test::Benchmark::timing<500>("\tBuffered         ", std::bind(&test::buffered_clustering, points, 0.2));
+        test::Benchmark::timing<500>("\tBuffered   (bulk)", std::bind(&test::buffered_clustering_bulk, points, 0.2));
+        test::Benchmark::timing<500>("\tCompact          ", std::bind(&test::compact_clustering, points, 0.2));
+        test::Benchmark::timing<500>("\tCompact    (bulk)", std::bind(&test::compact_clustering_bulk, points, 0.2));
+        test::Benchmark::timing<500>("\tHashed           ", std::bind(&test::hashed_clustering, points, 0.2));
+        test::Benchmark::timing<500>("\tHashed     (bulk)", std::bind(&test::hashed_clustering_bulk, points, 0.2));
+        test::Benchmark::timing<500>("\tMorton     (bulk)", std::bind(&test::morton_clustering_bulk, points, 0.2));
+    }
+    {
+        KDTreeUnbuffered unbuffered;
+        KDTreeBuffered buffered(test::reserve(0.2, points.size()));
+        KDTreeCompact compact(test::reserve(0.2, points.size()));
+        KDTreeHashed hashed(test::reserve(0.2, points.size()));
+        KDTreeMorton morton(test::reserve(0.2, points.size()));
+        test::Benchmark::timing<500>("\tUnbuffered        (reuse): ", std::bind(&test::reuse_clustering<KDTreeUnbuffered>, std::cref(points), std::ref(unbuffered)));
+        test::Benchmark::timing<500>("\tUnbuffered (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeUnbuffered>, points, std::ref(unbuffered)));
+        test::Benchmark::timing<500>("\tBuffered          (reuse): ", std::bind(&test::reuse_clustering<KDTreeBuffered>, points, std::ref(buffered)));
+        test::Benchmark::timing<500>("\tBuffered   (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeBuffered>, points, std::ref(buffered)));
+        test::Benchmark::timing<500>("\tCompact           (reuse): ", std::bind(&test::reuse_clustering<KDTreeCompact>, points, std::ref(compact)));
+        test::Benchmark::timing<500>("\tCompact    (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeCompact>, points, std::ref(compact)));
+        test::Benchmark::timing<500>("\tHashed            (reuse): ", std::bind(&test::reuse_clustering<KDTreeHashed>, points, std::ref(hashed)));
+        test::Benchmark::timing<500>("\tHashed     (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeHashed>, points, std::ref(hashed)));
+        test::Benchmark::timing<500>("\tMorton     (bulk) (reuse): ", std::bind(&test::reuse_clustering_bulk<KDTreeMorton>, points, std::ref(morton)));
+    }
+
+    std::cout << std::endl
+              << "Bulk staging: " << std::endl
+              << "\tExpected: cells visible after load_bulk only, clear_bulk discards them" << std::endl
+              << "Runs: " << std::endl;
+    {
+        std::cout << "\tUnbuffered: " << (test::bulk_staged<KDTreeUnbuffered>(points) ? "yes" : "no") << std::endl
+                  << "\tBuffered  : " << (test::bulk_staged<KDTreeBuffered>(points) ? "yes" : "no") << std::endl
+                  << "\tCompact   : " << (test::bulk_staged<KDTreeCompact>(points) ? "yes" : "no") << std::endl
+                  << "\tHashed    : " << (test::bulk_staged<KDTreeHashed>(points) ? "yes" : "no") << std::endl
+                  << "\tMorton    : " << (test::bulk_staged<KDTreeMorton>(points) ? "yes" : "no") << std::endl;
+    }
+
+    std::cout << std::endl
+              << "Predicates: " << std::endl
+              << "\tExpected: compile time predicates no slower than std::function" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeUnbuffered tree;
+        for (const Point& sample : points)
+            tree.insert_bulk(Index::create(sample), Data::create(sample));
+        tree.load_bulk();
+
+        auto init = [](const Data& data) { return data.weight > 0.0; };
+        auto extend = [](const Data& node, const Data& neighbour) { return node.weight + neighbour.weight > 0.0; };
+
+        using AcceptStatic = kdtree::KDTreeClusteringStatic<KDTreeUnbuffered>;
+        using ClusteringStatic = kdtree::KDTreeClusteringStatic<KDTreeUnbuffered, decltype(init), decltype(extend)>;
+        using ClusteringDynamic = kdtree::KDTreeClustering<KDTreeUnbuffered>;   /// set_cluster_* as before static predicates
+
+        AcceptStatic accept_static(tree);
+        ClusteringDynamic accept_dynamic(tree);
+        ClusteringStatic weight_static(tree, init, extend);
+        ClusteringDynamic weight_dynamic(tree);
+        weight_dynamic.set_cluster_init(init);
+        weight_dynamic.set_cluster_extend(extend);
+
+        test::Benchmark::timing<500>("\tAccept (static) : ", std::bind(&test::cluster_only<AcceptStatic>, std::ref(tree), std::ref(accept_static)));
+        test::Benchmark::timing<500>("\tAccept (dynamic): ", std::bind(&test::cluster_only<ClusteringDynamic>, std::ref(tree), std::ref(accept_dynamic)));
+        test::Benchmark::timing<500>("\tWeight (static) : ", std::bind(&test::cluster_only<ClusteringStatic>, std::ref(tree), std::ref(weight_static)));
+        test::Benchmark::timing<500>("\tWeight (dynamic): ", std::bind(&test::cluster_only<ClusteringDynamic>, std::ref(tree), std::ref(weight_dynamic)));
+    }
+
+    std::cout << std::endl
+              << "Bulk buffer: " << std::endl
+              << "\tExpected: mixing hash with few probes per lookup, fill with statistics about the same time" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::bulk_buffer_statistics<test::LegacyHash>(points, "\tLegacy hash");
+        test::bulk_buffer_statistics<std::hash<Index::Type>>(points, "\tMixing hash");
+
+        typedef kdtree::FlatHashMap<Index::Type, Data> Buffer;
+        typedef kdtree::FlatHashMap<Index::Type, Data, std::hash<Index::Type>, true> CountingBuffer;
+        Buffer mixing;
+        CountingBuffer counting;
+        test::Benchmark::timing<500>("\tMixing hash fill: ", std::bind(&test::bulk_buffer_fill<Buffer>, std::cref(points), std::ref(mixing)));
+        test::Benchmark::timing<500>("\tMixing hash fill (statistics): ", std::bind(&test::bulk_buffer_fill<CountingBuffer>, std::cref(points), std::ref(counting)));
+    }
+
+    std::cout << std::endl
+              << "Parallel bulk: " << std::endl
+              << "\tExpected: same tree as sequential, faster with more threads" << std::endl
+              << "\tHardware threads: " << std::thread::hardware_concurrency() << std::endl
+              << "Runs: " << std::endl;
+    for (std::size_t threads : {1, 2, 4, 8})
+    {
+        std::cout << "\t" << threads << " threads equal to sequential: "
+                  << (test::parallel_equals_sequential(points, threads) ? "yes" : "no") << std::endl;
+        test::Benchmark::timing<500>("\tUnbuffered (parallel bulk) x" + std::to_string(threads),
+                                     std::bind(&test::unbuffered_clustering_parallel, std::cref(points), threads));
+    }
+
+    std::cout << std::endl
+              << "Parallel clustering: " << std::endl
+              << "\tExpected: same labels as serial, faster with more threads" << std::endl
+              << "Runs: " << std::endl;
+    for (std::size_t threads : {1, 2, 4, 8})
+    {
+        std::cout << "\t" << threads << " threads equal to serial: "
+                  << (test::parallel_clustering_equals_serial(points, threads) ? "yes" : "no") << std::endl;
+        test::Benchmark::timing<500>("\tUnbuffered (bulk) (parallel clustering) x" + std::to_string(threads),
+                                     std::bind(&test::unbuffered_clustering_parallel_cluster, std::cref(points), threads));
+    }
+
+    std::cout << std::endl
+              << "Find: " << std::endl
+              << "\tExpected: hashed with one probe faster than the descents" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeUnbuffered unbuffered;
+        KDTreeBuffered buffered(test::reserve(0.2, points.size()));
+        KDTreeCompact compact(test::reserve(0.2, points.size()));
+        KDTreeHashed hashed(test::reserve(0.2, points.size()));
+        KDTreeMorton morton(test::reserve(0.2, points.size()));
+        for (const Point& sample : points)
+        {
+            unbuffered.insert(Index::create(sample), Data::create(sample));
+            buffered.insert(Index::create(sample), Data::create(sample));
+            compact.insert(Index::create(sample), Data::create(sample));
+            hashed.insert(Index::create(sample), Data::create(sample));
+            morton.insert_bulk(Index::create(sample), Data::create(sample));
+        }
+        morton.load_bulk();
+        test::Benchmark::timing<500>("\tUnbuffered: ", std::bind(&test::find_all<KDTreeUnbuffered>, std::cref(points), std::ref(unbuffered)));
+        test::Benchmark::timing<500>("\tBuffered  : ", std::bind(&test::find_all<KDTreeBuffered>, std::cref(points), std::ref(buffered)));
+        test::Benchmark::timing<500>("\tCompact   : ", std::bind(&test::find_all<KDTreeCompact>, std::cref(points), std::ref(compact)));
+        test::Benchmark::timing<500>("\tHashed    : ", std::bind(&test::find_all<KDTreeHashed>, std::cref(points), std::ref(hashed)));
+        test::Benchmark::timing<500>("\tMorton    : ", std::bind(&test::find_all<KDTreeMorton>, std::cref(points), std::ref(morton)));
+    }
+
+    std::cout << std::endl
+              << "Neighbourhood: " << std::endl
+              << "\tExpected: shared descent not slower than a find per offset, half at half the cost" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeUnbuffered unbuffered;
+        KDTreeBuffered buffered(test::reserve(0.2, points.size()));
+        KDTreeCompact compact(test::reserve(0.2, points.size()));
+        test::neighbours(points, unbuffered, "\tUnbuffered");
+        test::neighbours(points, buffered, "\tBuffered  ");
+        test::neighbours(points, compact, "\tCompact   ");
+        KDTreeHashed hashed(test::reserve(0.2, points.size()));
+        test::neighbours(points, hashed, "\tHashed    ");
+        KDTreeMorton morton(test::reserve(0.2, points.size()));
+        test::neighbours(points, morton, "\tMorton    ");
+    }
+
+    std::cout << std::endl
+              << "Grid clustering: " << std::endl
+              << "\tExpected: grid for small bounds, same labels as the tree, faster" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::grid_clustering<KDTreeUnbuffered>(points, "\tUnbuffered");
+        test::grid_clustering<KDTreeCompact>(points, "\tCompact   ");
+
+        KDTreeUnbuffered tree;
+        for (const Point& sample : points)
+            tree.insert_bulk(Index::create(sample), Data::create(sample));
+        tree.load_bulk();
+
+        using GridClustering = kdtree::KDTreeGridClustering<KDTreeUnbuffered>;
+        ClusteringUnbuffered clustering(tree);
+        GridClustering grid(tree);
+        test::Benchmark::timing<500>("\tUnbuffered (tree): ", std::bind(&test::grid_cluster_only<KDTreeUnbuffered, ClusteringUnbuffered>, std::ref(tree), std::ref(clustering)));
+        test::Benchmark::timing<500>("\tUnbuffered (grid): ", std::bind(&test::grid_cluster_only<KDTreeUnbuffered, GridClustering>, std::ref(tree), std::ref(grid)));
+    }
+
+    std::cout << std::endl
+              << "Incremental clustering: " << std::endl
+              << "\tExpected: 9 clusters, same partition as cluster(), faster than clustering every cycle" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::incremental_clustering<KDTreeUnbuffered>(points, "\tUnbuffered");
+        test::incremental_clustering<KDTreeBuffered>(points, "\tBuffered  ");
+        test::incremental_clustering<KDTreeCompact>(points, "\tCompact   ");
+        test::incremental_clustering<KDTreeHashed>(points, "\tHashed    ");
+        test::Benchmark::timing<10>("\t10 cycles (batch)      : ", std::bind(&test::cycles_batch, std::cref(points), 10));
+        test::Benchmark::timing<10>("\t10 cycles (incremental): ", std::bind(&test::cycles_incremental, std::cref(points), 10));
+    }
+
+    std::cout << std::endl
+              << "Connectivity: " << std::endl
+              << "\tExpected: fewer offsets cluster faster, face / edge may split clusters" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeUnbuffered tree;
+        for (const Point& sample : points)
+            tree.insert_bulk(Index::create(sample), Data::create(sample));
+        tree.load_bulk();
+
+        test::connectivity<kdtree::ConnectivityFace>(tree, points, "\tFace    ");
+        test::connectivity<kdtree::ConnectivityEdge>(tree, points, "\tEdge    ");
+        test::connectivity<kdtree::ConnectivityFull>(tree, points, "\tFull    ");
+        test::connectivity<kdtree::ConnectivityRadius<2>>(tree, points, "\tRadius 2");
+    }
+
+    std::cout << std::endl
+              << "Nearest neighbours: " << std::endl
+              << "\tExpected: knn equal to a brute force scan and much faster" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::knn<KDTreeUnbuffered>(points, "\tUnbuffered");
+        test::knn<KDTreeBuffered>(points, "\tBuffered  ");
+    }
+
+    std::cout << std::endl
+              << "Range queries: " << std::endl
+              << "\tExpected: box and radius queries equal to a scan, faster than traverse or find on a mostly empty box" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::range<KDTreeUnbuffered>(points, "\tUnbuffered");
+        test::range<KDTreeBuffered>(points, "\tBuffered  ");
+    }
+
+    std::cout << std::endl
+              << "Cluster statistics: " << std::endl
+              << "\tExpected: moments gathered while clustering equal a second pass, one pass no slower" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeUnbuffered tree;
+        for (const Point& sample : points)
+            tree.insert_bulk(Index::create(sample), Data::create(sample));
+        tree.load_bulk();
+
+        ClusteringUnbuffered clustering(tree);
+        test::ClusterMoments moments;
+        std::cout << "\tequal to second pass: " << (test::moments_equal_second_pass(tree, clustering) ? "yes" : "no") << std::endl;
+        test::Benchmark::timing<500>("\tTwo passes: ", std::bind(&test::moments_two_pass, std::ref(tree), std::ref(clustering), std::ref(moments)));
+        test::Benchmark::timing<500>("\tOne pass  : ", std::bind(&test::moments_one_pass, std::ref(tree), std::ref(clustering), std::ref(moments)));
+    }
+
+    std::cout << std::endl
+              << "Erase: " << std::endl
+              << "\tExpected: trees equal to ones built without the erased cells, erase faster than rebuild" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::erase<KDTreeUnbuffered>(points, "\tUnbuffered");
+        test::erase<KDTreeBuffered>(points, "\tBuffered  ");
+        test::Benchmark::timing<50>("\tUnbuffered (erase)  : ", std::bind(&test::window_erase<KDTreeUnbuffered>, std::cref(points)));
+        test::Benchmark::timing<50>("\tUnbuffered (rebuild): ", std::bind(&test::window_rebuild<KDTreeUnbuffered>, std::cref(points)));
+        test::Benchmark::timing<50>("\tBuffered   (erase)  : ", std::bind(&test::window_erase<KDTreeBuffered>, std::cref(points)));
+        test::Benchmark::timing<50>("\tBuffered   (rebuild): ", std::bind(&test::window_rebuild<KDTreeBuffered>, std::cref(points)));
+    }
+
+    std::cout << std::endl
+              << "Periodic yaw: " << std::endl
+              << "\tExpected: samples turned across +-pi split without wrapping (not periodic, plain array), 9 clusters with it" << std::endl
+              << "Runs: " << std::endl;
+    {
+        const Points wrapped = test::turned(points, 2.2);
+        std::cout << "\tNot periodic: " << test::tree_cluster_count<KDTreeUnbuffered>(wrapped) << " cluster" << std::endl;
+        test::periodic<KDTreePeriodic>(wrapped, "\tPeriodic");
+
+        test::PageCells cells;
+        test::page_cells<KDTreePeriodic>(wrapped, cells);
+        using PagePeriodic  = kdtree::PageClustering<test::PageCell, Index::Dimension, IndexPeriodic>;
+        using ArrayPeriodic = kdtree::ArrayClustering<test::PageCell, Index::Dimension, IndexPeriodic>;
+        using ArrayPlain    = kdtree::ArrayClustering<test::PageCell, Index::Dimension>;
+        std::cout << "\tPeriodic page : " << test::page_clustering<PagePeriodic>(cells, nullptr) << " cluster" << std::endl;
+        std::cout << "\tPeriodic array: " << test::array_clustering<ArrayPeriodic>(cells) << " cluster" << std::endl;
+        std::cout << "\tPlain array   : " << test::array_clustering<ArrayPlain>(cells) << " cluster" << std::endl;
+    }
+
+    std::cout << std::endl
+              << "Page clustering: " << std::endl
+              << "\tExpected: 9 clusters, reset page at least as fast as a fresh one" << std::endl
+              << "Runs: " << std::endl;
+    {
+        test::PageCells cells;
+        test::page_cells(points, cells);
+        test::PageClustering::PageType page(test::PageClustering::PageType::Size{{1, 1, 1}});
+        const int fresh_count = test::page_clustering(cells, nullptr);
+        const int reset_count = test::page_clustering(cells, &page);
+        std::cout << "\tClusters fresh / reset: " << fresh_count << " / " << reset_count << std::endl;
+        test::Benchmark::timing<500>("\tFresh page: ", std::bind(&test::page_clustering<>, std::ref(cells), nullptr));
+        test::Benchmark::timing<500>("\tReset page: ", std::bind(&test::page_clustering<>, std::ref(cells), &page));
+    }
+
+    std::cout << std::endl
+              << "Index math: " << std::endl
+              << "\tExpected: vector operations faster than scalar" << std::endl
+              << "Runs: " << std::endl;
+    {
+        using Scalar = kdtree::ArrayOperationsScalar<Index::Dimension, int, int>;
+        using Vector = kdtree::ArrayOperations<Index::Dimension, int, int>;
+        test::Benchmark::timing<500>("\tScalar: ", std::bind(&test::index_math<Scalar>, std::cref(points)));
+        test::Benchmark::timing<500>("\tVector: ", std::bind(&test::index_math<Vector>, std::cref(points)));
+    }
+
+    std::cout << std::endl
+              << "Growth: " << std::endl
+              << "\tExpected: pre-sized chunks close to the legacy vector, growing from one chunk not slower than pre-sizing" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeBuffered tree;
+        for (const Point& sample : points)
+            tree.insert_bulk(Index::create(sample), Data::create(sample));
+        tree.load_bulk();
+        std::size_t nodes = 0;
+        tree.traverse_nodes([&nodes](KDTreeBuffered::NodeType&) { ++nodes; });
+        const std::size_t capacity = test::reserve(2.0, points.size());
+
+        volatile std::size_t sink = 0;
+        std::cout << "\tNodes per frame: " << nodes << ", legacy capacity: " << capacity << std::endl;
+        test::Benchmark::timing<500>("\tNodes (legacy vector) (pre-sized): ", [&]() { sink = sink + test::legacy_nodes(capacity, nodes); });
+        test::Benchmark::timing<500>("\tNodes (chunks)        (pre-sized): ", [&]() { sink = sink + test::chunk_nodes(capacity, nodes); });
+        test::Benchmark::timing<500>("\tNodes (chunks)        (grow)     : ", [&]() { sink = sink + test::chunk_nodes(0, nodes); });
+        test::Benchmark::timing<500>("\tBuffered   (bulk) (pre-sized): ", std::bind(&test::buffered_clustering_bulk, points, 2.0));
+        test::Benchmark::timing<500>("\tBuffered   (bulk) (grow)     : ", std::bind(&test::buffered_clustering_bulk, points, 0.0));
+        test::Benchmark::timing<500>("\tBuffered          (pre-sized): ", std::bind(&test::buffered_clustering, points, 2.0));
+        test::Benchmark::timing<500>("\tBuffered          (grow)     : ", std::bind(&test::buffered_clustering, points, 0.0));
+    }
+
+    std::cout << std::endl
+              << "Heap traffic: " << std::endl
+              << "\tExpected: 0 allocations in the second frame of a reused unbuffered tree" << std::endl
+              << "Runs: " << std::endl;
+    {
+        KDTreeWeight tree;
+        ClusteringWeight clustering(tree);
+        std::cout << "\tUnbuffered (insert)          : "
+                  << test::frame_allocations(std::bind(&test::weight_frame_insert, std::cref(points), std::ref(tree)))
+                  << " allocations" << std::endl;
+        std::cout << "\tUnbuffered (bulk) (clustering): "
+                  << test::frame_allocations(std::bind(&test::weight_frame_bulk_cluster, std::cref(points), std::ref(tree), std::ref(clustering)))
+                  << " allocations" << std::endl;
     }
 
     std::cout << std::endl